@@ -7,6 +7,21 @@
 #define AILIB_ANN_H
 
 #include "mat.h"
+#include <stddef.h>
+
+//Largest layer width that gets a specialized kernel
+#define ANN_SMALL_MAX 16
+
+typedef void (*ann_kernel_t)(const float*, const float*, const float*, float*);
+
+#define ANN_RNG_CORNERS 8
+
+typedef struct ann_rng ann_rng_t;
+struct ann_rng {
+    unsigned int seed;
+    int prev_idx;
+    float corners[ANN_RNG_CORNERS];
+};
 
 typedef struct ann ann_t;
 struct ann {
@@ -15,14 +30,23 @@ struct ann {
     int *layer_sizes;
     mat_t *weights;
     mat_t *biases;
+    ann_kernel_t *kernels;  //NULL unless every layer is <= ANN_SMALL_MAX wide
 };
 
 ann_t ann_create(int, int*, float);
+ann_t ann_alloc(int, int*, float);
+ann_t ann_copy(ann_t);
 int ann_activate(ann_t, float*, float*);
+int ann_activate_batch(ann_t, int, float*, float*);
+int ann_train(ann_t, float*, float*);
 void ann_setseed(unsigned int);
+ann_rng_t ann_getrng(void);
+void ann_setrng(ann_rng_t);
 void ann_randomizelayer(ann_t, int);
 mat_t ann_getlayer(ann_t, int);
 void ann_setlayer(ann_t, int, mat_t);
+size_t ann_serialize(ann_t, void*);
+int ann_deserialize(void*, size_t, ann_t*);
 void ann_delete(ann_t);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+// Copyright (c) 2017 Himanshu Goel
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef AILIB_ANN_BANK_H
+#define AILIB_ANN_BANK_H
+
+#include "mat.h"
+#include "ann.h"
+
+//A bank of same-topology networks stored model-interleaved: weight (x, y)
+//of layer i for model k lives at mat_get(weights[i], x * h + y, k), so one
+//SIMD load covers that weight for 8 models.
+//
+//ann_bank_train is textbook per-sample SGD: errors are propagated through
+//W^T and the weight gradient is error * a[i - 1]^T. This is NOT what
+//ann_train does (it uses a[L] and an untransposed W), so a bank does not
+//reproduce K separate ann_train runs. ann_bank_getmodel doesn't touch the
+//ann rng.
+typedef struct ann_bank ann_bank_t;
+struct ann_bank {
+    int models;
+    int layers;
+    int *layer_sizes;
+    mat_t learning_rates;
+    mat_t *weights;
+    mat_t *biases;
+};
+
+ann_bank_t ann_bank_create(int models, int layers, int *layer_sizes, float *learning_rates);
+void ann_bank_setmodel(ann_bank_t bank, int model, ann_t ann);
+ann_t ann_bank_getmodel(ann_bank_t bank, int model);
+int ann_bank_activate(ann_bank_t bank, float* inputs, float* outputs);
+int ann_bank_activate_mean(ann_bank_t bank, float* inputs, float* outputs);
+int ann_bank_train(ann_bank_t bank, float* inputs, float* expected_outputs);
+void ann_bank_delete(ann_bank_t bank);
+
+#endif
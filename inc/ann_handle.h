@@ -0,0 +1,25 @@
+// Copyright (c) 2017 Himanshu Goel
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef AILIB_ANN_HANDLE_H
+#define AILIB_ANN_HANDLE_H
+
+#include "ann.h"
+
+//Epoch based handle for serving an ann_t while it is being trained.
+//One trainer thread publishes immutable snapshots, up to max_readers
+//threads (each with its own reader index) read the latest one wait-free.
+typedef struct ann_handle ann_handle_t;
+
+ann_handle_t* ann_handle_create(ann_t initial, int max_readers);
+int ann_handle_register(ann_handle_t* handle);
+ann_t ann_handle_acquire(ann_handle_t* handle, int reader);
+void ann_handle_release(ann_handle_t* handle, int reader);
+int ann_handle_activate(ann_handle_t* handle, int reader, float* inputs, float* outputs);
+void ann_handle_publish(ann_handle_t* handle, ann_t ann);
+int ann_handle_reclaim(ann_handle_t* handle);
+void ann_handle_delete(ann_handle_t* handle);
+
+#endif
@@ -0,0 +1,27 @@
+// Copyright (c) 2017 Himanshu Goel
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef AILIB_ANN_TUNE_H
+#define AILIB_ANN_TUNE_H
+
+#include "ann.h"
+
+//Benchmarks every mat_mult/mat_multadd kernel variant on the layer shapes
+//of ann and stores the fastest in each weight matrix with mat_settune.
+//Results are cached per host in cache_path (NULL uses $AILIB_TUNE_CACHE,
+//or no cache if unset). Returns the number of shapes that had to be
+//benchmarked, -1 on error. Processes sharing one cache file take turns
+//through cache_path.lock and merge their results into it.
+//
+//Nets with the small per-layer kernels (ann.kernels != NULL) are left
+//alone and 0 is returned, their inference never goes through mat_multadd.
+//
+//Benchmarking only touches private scratch matrices, but the choices are
+//written into ann itself, so ann must not be in use by another thread.
+//Tune the trainer's copy: snapshots published through ann_handle carry
+//the choice along via ann_copy.
+int ann_autotune(ann_t ann, const char *cache_path);
+
+#endif
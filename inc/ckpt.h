@@ -0,0 +1,31 @@
+// Copyright (c) 2017 Himanshu Goel
+//
+// This software is released under the MIT License.
+// https://opensource.org/licenses/MIT
+
+#ifndef AILIB_CKPT_H
+#define AILIB_CKPT_H
+
+#include <stddef.h>
+#include "ann.h"
+#include "ga.h"
+
+//Serializes a GA member into buf and returns its size, a NULL buf only
+//queries the size. MemberLoad rebuilds a member from those bytes.
+typedef size_t (*MemberSave)(void *member, void *buf);
+typedef void* (*MemberLoad)(void *buf, size_t sz);
+
+//Background checkpoint writer. ckpt_save copies the training state into a
+//spare buffer and returns, a worker thread writes it to path.tmp and
+//renames it over path. Only one thread may call ckpt_save at a time.
+//ckpt_load fills nets with newly created networks and replaces the members
+//of an existing ga (same pop_sz), then restores both rng states.
+typedef struct ckpt ckpt_t;
+
+ckpt_t* ckpt_create(const char *path);
+int ckpt_save(ckpt_t *ckpt, ann_t *nets, int net_cnt, ga_t *ga, MemberSave save);
+int ckpt_wait(ckpt_t *ckpt);
+int ckpt_delete(ckpt_t *ckpt);
+int ckpt_load(const char *path, ann_t *nets, int net_cnt, ga_t *ga, MemberLoad load);
+
+#endif
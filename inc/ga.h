@@ -13,6 +13,15 @@ typedef void* (*MemberMutate)(void *);
 typedef void* (*MemberMerge)(void *, void *);
 typedef void (*MemberKill)(void*);
 
+#define GA_RNG_CORNERS 8
+
+typedef struct ga_rng ga_rng_t;
+struct ga_rng {
+    unsigned int seed;
+    int prev_idx;
+    float corners[GA_RNG_CORNERS];
+};
+
 typedef struct ga ga_t;
 struct ga {
     MemberIniter init;
@@ -31,5 +40,7 @@ struct ga {
 ga_t ga_create(int pop_sz, float mutation_rate, MemberIniter init, FitnessFunction fitness, MemberMutate mutator, MemberMerge merger, MemberKill murderer);
 int ga_iteration(ga_t ga, void** fittest);
 void ga_setseed(unsigned int);
+ga_rng_t ga_getrng(void);
+void ga_setrng(ga_rng_t);
 
 #endif
\ No newline at end of file
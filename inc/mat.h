@@ -6,16 +6,53 @@
 #ifndef AILIB_MAT_H
 #define AILIB_MAT_H
 
+#include <stddef.h>
+
+//Storage backend for mat_t. alloc must return 32 byte aligned memory of
+//at least sz bytes, zeroed says whether that memory is already zero filled.
+typedef struct mat_allocator mat_allocator_t;
+struct mat_allocator {
+    void* (*alloc)(size_t sz, void *ctx);
+    void (*free)(void *ptr, size_t sz, void *ctx);
+    int zeroed;
+    void *ctx;
+};
+
+extern const mat_allocator_t mat_allocator_default;
+extern const mat_allocator_t mat_allocator_lazy;
+extern const mat_allocator_t mat_allocator_thp;
+extern const mat_allocator_t mat_allocator_hugetlb;
+//node < 0 follows the touching thread, NULL if node >= MAT_NUMA_MAX_NODES
+#define MAT_NUMA_MAX_NODES 64
+const mat_allocator_t* mat_allocator_numa(int node);
+
+//The current allocator is per thread: matrices created on other threads,
+//including ann_activate temporaries and ann_handle snapshots, keep using
+//the default until those threads set one too. NULL restores the default.
+void mat_setallocator(const mat_allocator_t*);
+const mat_allocator_t* mat_getallocator(void);
+
+//Register blocking used by mat_mult/mat_multadd when the matrix is the
+//left hand side of a matrix-vector product
+typedef struct mat_tune mat_tune_t;
+struct mat_tune {
+    int strips;
+    int unroll;
+};
+
 typedef struct mat mat_t;
 struct mat{
     int width;
     int height;
     int stride;
-    int alloc_sz;
+    size_t alloc_sz;
     float *data;
+    const mat_allocator_t *allocator;
+    int variant;    //kernel variant, see mat_settune
 };
 
 mat_t mat_create(int, int);
+mat_t mat_create_alloc(int, int, const mat_allocator_t*);
 void mat_delete(mat_t);
 void mat_set(mat_t, int, int, float);
 float mat_get(mat_t, int, int);
@@ -24,5 +61,9 @@ int mat_mult(mat_t, mat_t, mat_t*);
 int mat_multadd(mat_t, mat_t, mat_t, mat_t*);
 int mat_transpose(mat_t, mat_t*);
 int mat_subscalar(mat_t, float, mat_t*);
+int mat_tunecnt(void);
+mat_tune_t mat_tunevariant(int);
+int mat_settune(mat_t*, mat_tune_t);
+mat_tune_t mat_gettune(mat_t);
 
 #endif
\ No newline at end of file
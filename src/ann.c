@@ -7,13 +7,15 @@
 
 #include "ann.h"
 #include "mat.h"
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
 #include <math.h>
 #include <x86intrin.h>
 
 static unsigned int seed = 0;
-#define CORNER_CNT 8
+#define CORNER_CNT ANN_RNG_CORNERS
 static float corners[CORNER_CNT];
 static int prev_idx = 0;
 
@@ -39,6 +41,71 @@ void ann_setseed(unsigned int s) {
         ann_rand();
 }
 
+ann_rng_t ann_getrng(void) {
+    ann_rng_t rng;
+    rng.seed = seed;
+    rng.prev_idx = prev_idx;
+    memcpy(rng.corners, corners, sizeof(corners));
+    return rng;
+}
+
+void ann_setrng(ann_rng_t rng) {
+    seed = rng.seed;
+    prev_idx = rng.prev_idx;
+    memcpy(corners, rng.corners, sizeof(corners));
+}
+
+//Fully unrolled layer kernels for tiny networks, one per input width.
+//Weight columns and biases are padded to 8 or 16 floats by mat_create, so
+//a layer with <= 8 outputs fits in one register and <= 16 in two.
+#define ANN_SMALL_KERNEL(N) \
+static void ann_small8_##N(const float *w, const float *b, const float *in, float *out) { \
+    __m256 acc = _mm256_load_ps(b); \
+    _Pragma("GCC unroll 16") \
+    for(int x = 0; x < N; x++) \
+        acc = _mm256_fmadd_ps(_mm256_load_ps(w + 8 * x), _mm256_set1_ps(in[x]), acc); \
+    _mm256_store_ps(out, _mm256_max_ps(acc, _mm256_setzero_ps())); \
+} \
+static void ann_small16_##N(const float *w, const float *b, const float *in, float *out) { \
+    __m256 acc0 = _mm256_load_ps(b); \
+    __m256 acc1 = _mm256_load_ps(b + 8); \
+    _Pragma("GCC unroll 16") \
+    for(int x = 0; x < N; x++) { \
+        __m256 in_v = _mm256_set1_ps(in[x]); \
+        acc0 = _mm256_fmadd_ps(_mm256_load_ps(w + 16 * x), in_v, acc0); \
+        acc1 = _mm256_fmadd_ps(_mm256_load_ps(w + 16 * x + 8), in_v, acc1); \
+    } \
+    _mm256_store_ps(out, _mm256_max_ps(acc0, _mm256_setzero_ps())); \
+    _mm256_store_ps(out + 8, _mm256_max_ps(acc1, _mm256_setzero_ps())); \
+}
+
+ANN_SMALL_KERNEL(1)  ANN_SMALL_KERNEL(2)  ANN_SMALL_KERNEL(3)  ANN_SMALL_KERNEL(4)
+ANN_SMALL_KERNEL(5)  ANN_SMALL_KERNEL(6)  ANN_SMALL_KERNEL(7)  ANN_SMALL_KERNEL(8)
+ANN_SMALL_KERNEL(9)  ANN_SMALL_KERNEL(10) ANN_SMALL_KERNEL(11) ANN_SMALL_KERNEL(12)
+ANN_SMALL_KERNEL(13) ANN_SMALL_KERNEL(14) ANN_SMALL_KERNEL(15) ANN_SMALL_KERNEL(16)
+
+#define ANN_SMALL_ENTRY(N) { ann_small8_##N, ann_small16_##N }
+
+static const ann_kernel_t small_kernels[ANN_SMALL_MAX][2] = {
+    ANN_SMALL_ENTRY(1),  ANN_SMALL_ENTRY(2),  ANN_SMALL_ENTRY(3),  ANN_SMALL_ENTRY(4),
+    ANN_SMALL_ENTRY(5),  ANN_SMALL_ENTRY(6),  ANN_SMALL_ENTRY(7),  ANN_SMALL_ENTRY(8),
+    ANN_SMALL_ENTRY(9),  ANN_SMALL_ENTRY(10), ANN_SMALL_ENTRY(11), ANN_SMALL_ENTRY(12),
+    ANN_SMALL_ENTRY(13), ANN_SMALL_ENTRY(14), ANN_SMALL_ENTRY(15), ANN_SMALL_ENTRY(16),
+};
+
+static ann_kernel_t* ann_pick_kernels(int layers, int *layer_sizes) {
+    for(int i = 0; i < layers; i++)
+        if(layer_sizes[i] < 1 || layer_sizes[i] > ANN_SMALL_MAX)
+            return NULL;
+
+    ann_kernel_t *kernels = malloc(layers * sizeof(ann_kernel_t));
+    kernels[0] = NULL;
+    for(int i = 1; i < layers; i++)
+        kernels[i] = small_kernels[layer_sizes[i - 1] - 1][layer_sizes[i] > 8];
+
+    return kernels;
+}
+
 ann_t ann_create(int layers, int *layer_sizes, float learning_rate) {
     ann_t ann;
     ann.layers = layers;
@@ -48,6 +115,7 @@ ann_t ann_create(int layers, int *layer_sizes, float learning_rate) {
     ann.biases = malloc(layers * sizeof(mat_t));
 
     memcpy(ann.layer_sizes, layer_sizes, layers * sizeof(int));
+    ann.kernels = ann_pick_kernels(layers, layer_sizes);
     
     int w = layer_sizes[0];
 
@@ -72,6 +140,136 @@ ann_t ann_create(int layers, int *layer_sizes, float learning_rate) {
     return ann;
 }
 
+//allocates a zeroed network without touching the rng
+ann_t ann_alloc(int layers, int *layer_sizes, float learning_rate) {
+    ann_t ann;
+    ann.layers = layers;
+    ann.learning_rate = learning_rate;
+    ann.layer_sizes = malloc(layers * sizeof(int));
+    ann.weights = malloc(layers * sizeof(mat_t));
+    ann.biases = malloc(layers * sizeof(mat_t));
+
+    memcpy(ann.layer_sizes, layer_sizes, layers * sizeof(int));
+    ann.kernels = ann_pick_kernels(layers, layer_sizes);
+
+    for(int i = 1; i < layers; i++) {
+        ann.weights[i] = mat_create(layer_sizes[i - 1], layer_sizes[i]);
+        ann.biases[i] = mat_create(1, layer_sizes[i]);
+    }
+
+    return ann;
+}
+
+ann_t ann_copy(ann_t src) {
+    ann_t ann = ann_alloc(src.layers, src.layer_sizes, src.learning_rate);
+
+    for(int i = 1; i < src.layers; i++) {
+        ann.weights[i].variant = src.weights[i].variant;
+        memcpy(ann.weights[i].data, src.weights[i].data, src.weights[i].alloc_sz);
+        memcpy(ann.biases[i].data, src.biases[i].data, src.biases[i].alloc_sz);
+    }
+
+    return ann;
+}
+
+//Layout: layers, learning_rate, layer_sizes, the mat_tune_t of every weight
+//layer, then the raw (padded) weight and bias storage of every layer. The
+//tuned kernels sum in a different order, so they have to survive a reload
+//for training to resume bit exact. Passing a NULL buf returns the size.
+size_t ann_serialize(ann_t ann, void *buf) {
+    size_t sz = sizeof(int) + sizeof(float) + ann.layers * sizeof(int) + (ann.layers - 1) * sizeof(mat_tune_t);
+    for(int i = 1; i < ann.layers; i++)
+        sz += ann.weights[i].alloc_sz + ann.biases[i].alloc_sz;
+
+    if(buf == NULL)
+        return sz;
+
+    uint8_t *dst = buf;
+    memcpy(dst, &ann.layers, sizeof(int)); dst += sizeof(int);
+    memcpy(dst, &ann.learning_rate, sizeof(float)); dst += sizeof(float);
+    memcpy(dst, ann.layer_sizes, ann.layers * sizeof(int)); dst += ann.layers * sizeof(int);
+
+    for(int i = 1; i < ann.layers; i++) {
+        mat_tune_t tune = mat_gettune(ann.weights[i]);
+        memcpy(dst, &tune, sizeof(mat_tune_t)); dst += sizeof(mat_tune_t);
+    }
+
+    for(int i = 1; i < ann.layers; i++) {
+        memcpy(dst, ann.weights[i].data, ann.weights[i].alloc_sz); dst += ann.weights[i].alloc_sz;
+        memcpy(dst, ann.biases[i].data, ann.biases[i].alloc_sz); dst += ann.biases[i].alloc_sz;
+    }
+
+    return sz;
+}
+
+int ann_deserialize(void *buf, size_t sz, ann_t *ann) {
+    uint8_t *src = buf;
+    int layers;
+    float learning_rate;
+
+    if(sz < sizeof(int) + sizeof(float))
+        return -1;
+    memcpy(&layers, src, sizeof(int)); src += sizeof(int);
+    memcpy(&learning_rate, src, sizeof(float)); src += sizeof(float);
+
+    if(layers < 1 || sz < sizeof(int) + sizeof(float) + layers * sizeof(int) + (layers - 1) * sizeof(mat_tune_t))
+        return -1;
+
+    int *layer_sizes = malloc(layers * sizeof(int));
+    memcpy(layer_sizes, src, layers * sizeof(int)); src += layers * sizeof(int);
+    uint8_t *tunes = src;
+    src += (layers - 1) * sizeof(mat_tune_t);
+
+    //work out the payload size from the header before allocating anything,
+    //so a corrupt layer size can't trigger a huge allocation
+    size_t expected = sizeof(int) + sizeof(float) + layers * sizeof(int) + (layers - 1) * sizeof(mat_tune_t);
+    for(int i = 0; i < layers; i++) {
+        if(layer_sizes[i] < 1 || layer_sizes[i] > INT_MAX - 8)
+            goto fail;
+        if(i == 0)
+            continue;
+
+        size_t stride = ((size_t)layer_sizes[i] + 7) / 8 * 8;
+        size_t cols = (size_t)layer_sizes[i - 1] + 1;  //weights plus the bias column
+        if(cols > SIZE_MAX / (stride * sizeof(float)))
+            goto fail;
+
+        size_t layer_sz = cols * stride * sizeof(float);
+        if(layer_sz > sz - expected)
+            goto fail;
+        expected += layer_sz;
+    }
+
+    if(expected != sz)
+        goto fail;
+
+    //an unknown kernel variant means the file came from another build
+    mat_t probe = {0};
+    for(int i = 1; i < layers; i++) {
+        mat_tune_t tune;
+        memcpy(&tune, tunes + (i - 1) * sizeof(mat_tune_t), sizeof(mat_tune_t));
+        if(mat_settune(&probe, tune) != 0)
+            goto fail;
+    }
+
+    *ann = ann_alloc(layers, layer_sizes, learning_rate);
+    free(layer_sizes);
+
+    for(int i = 1; i < layers; i++) {
+        mat_tune_t tune;
+        memcpy(&tune, tunes, sizeof(mat_tune_t)); tunes += sizeof(mat_tune_t);
+        mat_settune(&ann->weights[i], tune);
+        memcpy(ann->weights[i].data, src, ann->weights[i].alloc_sz); src += ann->weights[i].alloc_sz;
+        memcpy(ann->biases[i].data, src, ann->biases[i].alloc_sz); src += ann->biases[i].alloc_sz;
+    }
+
+    return 0;
+
+fail:
+    free(layer_sizes);
+    return -1;
+}
+
 void ann_delete(ann_t ann) {
     free(ann.layer_sizes);
 
@@ -81,6 +279,8 @@ void ann_delete(ann_t ann) {
     }
 
     free(ann.weights);
+    free(ann.biases);
+    free(ann.kernels);
 }
 
 static void ann_softsign(mat_t a, mat_t *c) {
@@ -162,7 +362,25 @@ static void ann_hadamard(mat_t a, mat_t z, mat_t *c) {
     }
 }
 
+static void ann_activate_small(ann_t ann, float* inputs, float* outputs) {
+    _Alignas(32) float buf[2][ANN_SMALL_MAX];
+    int cur = 0;
+
+    memcpy(buf[0], inputs, ann.layer_sizes[0] * sizeof(float));
+    for(int i = 1; i < ann.layers; i++) {
+        ann.kernels[i](ann.weights[i].data, ann.biases[i].data, buf[cur], buf[cur ^ 1]);
+        cur ^= 1;
+    }
+
+    memcpy(outputs, buf[cur], ann.layer_sizes[ann.layers - 1] * sizeof(float));
+}
+
 int ann_activate(ann_t ann, float* inputs, float* outputs){
+    if(ann.kernels != NULL) {
+        ann_activate_small(ann, inputs, outputs);
+        return 0;
+    }
+
     mat_t res = mat_create(1, ann.layer_sizes[0]);
     for(int i = 0; i < ann.layer_sizes[0]; i++) {
         mat_set(res, 0, i, inputs[i]);
@@ -187,6 +405,56 @@ int ann_activate(ann_t ann, float* inputs, float* outputs){
     return 0;
 }
 
+//Evaluates 8 samples at once, one per lane, with activations stored
+//transposed so each neuron is a single register across the samples.
+static void ann_activate_small8(ann_t ann, int cnt, float* inputs, float* outputs) {
+    _Alignas(32) float buf[2][ANN_SMALL_MAX][8];
+    int cur = 0;
+    int in_sz = ann.layer_sizes[0];
+    int out_sz = ann.layer_sizes[ann.layers - 1];
+
+    memset(buf[0], 0, sizeof(buf[0]));
+    for(int s = 0; s < cnt; s++)
+        for(int x = 0; x < in_sz; x++)
+            buf[0][x][s] = inputs[s * in_sz + x];
+
+    for(int i = 1; i < ann.layers; i++) {
+        mat_t w = ann.weights[i];
+        mat_t b = ann.biases[i];
+
+        for(int y = 0; y < w.height; y++) {
+            __m256 acc = _mm256_set1_ps(b.data[y]);
+            for(int x = 0; x < w.width; x++)
+                acc = _mm256_fmadd_ps(_mm256_set1_ps(w.data[w.stride * x + y]), _mm256_load_ps(buf[cur][x]), acc);
+            _mm256_store_ps(buf[cur ^ 1][y], _mm256_max_ps(acc, _mm256_setzero_ps()));
+        }
+        cur ^= 1;
+    }
+
+    for(int s = 0; s < cnt; s++)
+        for(int y = 0; y < out_sz; y++)
+            outputs[s * out_sz + y] = buf[cur][y][s];
+}
+
+int ann_activate_batch(ann_t ann, int cnt, float* inputs, float* outputs) {
+    int in_sz = ann.layer_sizes[0];
+    int out_sz = ann.layer_sizes[ann.layers - 1];
+
+    if(ann.kernels == NULL) {
+        for(int s = 0; s < cnt; s++)
+            if(ann_activate(ann, inputs + s * in_sz, outputs + s * out_sz) != 0)
+                return -1;
+        return 0;
+    }
+
+    for(int s = 0; s < cnt; s += 8) {
+        int n = cnt - s < 8 ? cnt - s : 8;
+        ann_activate_small8(ann, n, inputs + s * in_sz, outputs + s * out_sz);
+    }
+
+    return 0;
+}
+
 float trans_deriv(float o) {
     return 1 / powf(1 + fabs(o), 2); 
 }
@@ -0,0 +1,244 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann_bank.h"
+#include "ann.h"
+#include "mat.h"
+#include <stdlib.h>
+#include <string.h>
+#include <x86intrin.h>
+
+ann_bank_t ann_bank_create(int models, int layers, int *layer_sizes, float *learning_rates) {
+    ann_bank_t bank;
+    bank.models = models;
+    bank.layers = layers;
+    bank.layer_sizes = malloc(layers * sizeof(int));
+    bank.weights = malloc(layers * sizeof(mat_t));
+    bank.biases = malloc(layers * sizeof(mat_t));
+    bank.learning_rates = mat_create(1, models);
+
+    memcpy(bank.layer_sizes, layer_sizes, layers * sizeof(int));
+
+    for(int i = 1; i < layers; i++) {
+        bank.weights[i] = mat_create(layer_sizes[i - 1] * layer_sizes[i], models);
+        bank.biases[i] = mat_create(layer_sizes[i], models);
+    }
+
+    //initialize every model exactly as a standalone ann_create would
+    for(int k = 0; k < models; k++) {
+        ann_t ann = ann_create(layers, layer_sizes, learning_rates[k]);
+        ann_bank_setmodel(bank, k, ann);
+        ann_delete(ann);
+    }
+
+    return bank;
+}
+
+void ann_bank_setmodel(ann_bank_t bank, int model, ann_t ann) {
+    mat_set(bank.learning_rates, 0, model, ann.learning_rate);
+
+    for(int i = 1; i < bank.layers; i++) {
+        int w = bank.layer_sizes[i - 1];
+        int h = bank.layer_sizes[i];
+
+        for(int y = 0; y < h; y++) {
+            mat_set(bank.biases[i], y, model, mat_get(ann.biases[i], 0, y));
+            for(int x = 0; x < w; x++)
+                mat_set(bank.weights[i], x * h + y, model, mat_get(ann.weights[i], x, y));
+        }
+    }
+}
+
+ann_t ann_bank_getmodel(ann_bank_t bank, int model) {
+    ann_t ann = ann_alloc(bank.layers, bank.layer_sizes, mat_get(bank.learning_rates, 0, model));
+
+    for(int i = 1; i < bank.layers; i++) {
+        int w = bank.layer_sizes[i - 1];
+        int h = bank.layer_sizes[i];
+
+        for(int y = 0; y < h; y++) {
+            mat_set(ann.biases[i], 0, y, mat_get(bank.biases[i], y, model));
+            for(int x = 0; x < w; x++)
+                mat_set(ann.weights[i], x, y, mat_get(bank.weights[i], x * h + y, model));
+        }
+    }
+
+    return ann;
+}
+
+//z = W * a + b for all models at once, a and z are (neurons x models)
+static void ann_bank_forward(mat_t w, mat_t b, mat_t a, mat_t *z, mat_t *out) {
+    int h = b.width;
+    int in_sz = a.width;
+
+    for(int j = 0; j < b.stride; j += 8) {
+        for(int y = 0; y < h; y++) {
+            __m256 acc = _mm256_load_ps(&b.data[b.stride * y + j]);
+            __m256 acc1 = _mm256_setzero_ps();
+
+            const float *src_w = &w.data[w.stride * y + j];
+            const float *src_a = &a.data[j];
+            const int w_step = w.stride * h;
+
+            int x = 0;
+            for(; x + 1 < in_sz; x += 2) {
+                acc = _mm256_fmadd_ps(_mm256_load_ps(src_w), _mm256_load_ps(src_a), acc);
+                acc1 = _mm256_fmadd_ps(_mm256_load_ps(src_w + w_step), _mm256_load_ps(src_a + a.stride), acc1);
+                src_w += 2 * w_step;
+                src_a += 2 * a.stride;
+            }
+            if(x < in_sz)
+                acc = _mm256_fmadd_ps(_mm256_load_ps(src_w), _mm256_load_ps(src_a), acc);
+
+            acc = _mm256_add_ps(acc, acc1);
+            _mm256_store_ps(&z->data[z->stride * y + j], acc);
+            _mm256_store_ps(&out->data[out->stride * y + j], _mm256_max_ps(acc, _mm256_setzero_ps()));
+        }
+    }
+}
+
+static mat_t* ann_bank_feedforward(ann_bank_t bank, float* inputs, mat_t *z) {
+    mat_t *a = malloc(bank.layers * sizeof(mat_t));
+
+    a[0] = mat_create(bank.layer_sizes[0], bank.models);
+    for(int x = 0; x < bank.layer_sizes[0]; x++)
+        for(int k = 0; k < bank.models; k++)
+            mat_set(a[0], x, k, inputs[x]);
+
+    for(int i = 1; i < bank.layers; i++) {
+        z[i] = mat_create(bank.layer_sizes[i], bank.models);
+        a[i] = mat_create(bank.layer_sizes[i], bank.models);
+        ann_bank_forward(bank.weights[i], bank.biases[i], a[i - 1], &z[i], &a[i]);
+    }
+
+    return a;
+}
+
+static void ann_bank_freelayers(ann_bank_t bank, mat_t *a, mat_t *z) {
+    mat_delete(a[0]);
+    for(int i = 1; i < bank.layers; i++) {
+        mat_delete(a[i]);
+        if(z != NULL)
+            mat_delete(z[i]);
+    }
+    free(a);
+}
+
+int ann_bank_activate(ann_bank_t bank, float* inputs, float* outputs) {
+    mat_t *z = malloc(bank.layers * sizeof(mat_t));
+    mat_t *a = ann_bank_feedforward(bank, inputs, z);
+
+    int out_sz = bank.layer_sizes[bank.layers - 1];
+    for(int k = 0; k < bank.models; k++)
+        for(int y = 0; y < out_sz; y++)
+            outputs[k * out_sz + y] = mat_get(a[bank.layers - 1], y, k);
+
+    ann_bank_freelayers(bank, a, z);
+    free(z);
+    return 0;
+}
+
+int ann_bank_activate_mean(ann_bank_t bank, float* inputs, float* outputs) {
+    mat_t *z = malloc(bank.layers * sizeof(mat_t));
+    mat_t *a = ann_bank_feedforward(bank, inputs, z);
+
+    int out_sz = bank.layer_sizes[bank.layers - 1];
+    for(int y = 0; y < out_sz; y++) {
+        float sum = 0;
+        for(int k = 0; k < bank.models; k++)
+            sum += mat_get(a[bank.layers - 1], y, k);
+        outputs[y] = sum / bank.models;
+    }
+
+    ann_bank_freelayers(bank, a, z);
+    free(z);
+    return 0;
+}
+
+int ann_bank_train(ann_bank_t bank, float* inputs, float* expected_outputs) {
+    if(bank.layers < 2)
+        return -1;
+
+    mat_t *z = malloc(bank.layers * sizeof(mat_t));
+    mat_t *errors = malloc(bank.layers * sizeof(mat_t));
+    mat_t *a = ann_bank_feedforward(bank, inputs, z);
+    const __m256 zero = _mm256_setzero_ps();
+
+    for(int i = 1; i < bank.layers; i++)
+        errors[i] = mat_create(bank.layer_sizes[i], bank.models);
+
+    //output error: (output - expected) hadamard relu'(z)
+    {
+        int last = bank.layers - 1;
+        mat_t e = errors[last];
+        for(int y = 0; y < bank.layer_sizes[last]; y++) {
+            __m256 expected_v = _mm256_set1_ps(expected_outputs[y]);
+            for(int j = 0; j < e.stride; j += 8) {
+                __m256 diff = _mm256_sub_ps(_mm256_load_ps(&a[last].data[a[last].stride * y + j]), expected_v);
+                __m256 deriv = _mm256_cmp_ps(_mm256_load_ps(&z[last].data[z[last].stride * y + j]), zero, _CMP_GT_OQ);
+                _mm256_store_ps(&e.data[e.stride * y + j], _mm256_and_ps(diff, deriv));
+            }
+        }
+    }
+
+    for(int i = bank.layers - 1; i > 0; i--) {
+        mat_t w = bank.weights[i];
+        mat_t b = bank.biases[i];
+        mat_t e = errors[i];
+        int in_sz = bank.layer_sizes[i - 1];
+        int h = bank.layer_sizes[i];
+
+        for(int j = 0; j < w.stride; j += 8) {
+            __m256 lr = _mm256_load_ps(&bank.learning_rates.data[j]);
+
+            //backpropagate through the weights before they are updated
+            if(i > 1) {
+                for(int x = 0; x < in_sz; x++) {
+                    __m256 acc = _mm256_setzero_ps();
+                    for(int y = 0; y < h; y++)
+                        acc = _mm256_fmadd_ps(_mm256_load_ps(&w.data[w.stride * (x * h + y) + j]), _mm256_load_ps(&e.data[e.stride * y + j]), acc);
+
+                    __m256 deriv = _mm256_cmp_ps(_mm256_load_ps(&z[i - 1].data[z[i - 1].stride * x + j]), zero, _CMP_GT_OQ);
+                    _mm256_store_ps(&errors[i - 1].data[errors[i - 1].stride * x + j], _mm256_and_ps(acc, deriv));
+                }
+            }
+
+            for(int y = 0; y < h; y++) {
+                __m256 step = _mm256_mul_ps(lr, _mm256_load_ps(&e.data[e.stride * y + j]));
+
+                float *dst_b = &b.data[b.stride * y + j];
+                _mm256_store_ps(dst_b, _mm256_sub_ps(_mm256_load_ps(dst_b), step));
+
+                for(int x = 0; x < in_sz; x++) {
+                    float *dst_w = &w.data[w.stride * (x * h + y) + j];
+                    __m256 a_v = _mm256_load_ps(&a[i - 1].data[a[i - 1].stride * x + j]);
+                    _mm256_store_ps(dst_w, _mm256_fnmadd_ps(step, a_v, _mm256_load_ps(dst_w)));
+                }
+            }
+        }
+    }
+
+    for(int i = 1; i < bank.layers; i++)
+        mat_delete(errors[i]);
+
+    ann_bank_freelayers(bank, a, z);
+    free(errors);
+    free(z);
+    return 0;
+}
+
+void ann_bank_delete(ann_bank_t bank) {
+    for(int i = 1; i < bank.layers; i++) {
+        mat_delete(bank.weights[i]);
+        mat_delete(bank.biases[i]);
+    }
+
+    mat_delete(bank.learning_rates);
+    free(bank.layer_sizes);
+    free(bank.weights);
+    free(bank.biases);
+}
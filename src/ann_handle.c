@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann_handle.h"
+#include "ann.h"
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#define READER_IDLE 0
+#define CACHE_LINE 64
+
+typedef struct ann_snapshot ann_snapshot_t;
+struct ann_snapshot {
+    ann_t ann;
+    unsigned long retire_epoch;
+};
+
+//Each reader gets its own cache line so announcing an epoch never bounces
+//a line shared with other readers.
+typedef struct ann_reader ann_reader_t;
+struct ann_reader {
+    _Alignas(CACHE_LINE) atomic_ulong epoch;
+    ann_snapshot_t *snapshot;
+};
+
+struct ann_handle {
+    _Alignas(CACHE_LINE) _Atomic(ann_snapshot_t*) current;
+    _Alignas(CACHE_LINE) atomic_ulong epoch;
+    atomic_int reader_cnt;
+    int max_readers;
+    ann_reader_t *readers;
+
+    //only touched by the publishing thread
+    ann_snapshot_t **retired;
+    int retired_cnt;
+    int retired_cap;
+};
+
+static ann_snapshot_t* ann_snapshot_create(ann_t ann) {
+    ann_snapshot_t *snap = malloc(sizeof(ann_snapshot_t));
+    snap->ann = ann_copy(ann);
+    snap->retire_epoch = 0;
+    return snap;
+}
+
+static void ann_snapshot_delete(ann_snapshot_t *snap) {
+    ann_delete(snap->ann);
+    free(snap);
+}
+
+ann_handle_t* ann_handle_create(ann_t initial, int max_readers) {
+    ann_handle_t *handle = aligned_alloc(CACHE_LINE, sizeof(ann_handle_t));
+
+    handle->max_readers = max_readers;
+    handle->readers = aligned_alloc(CACHE_LINE, max_readers * sizeof(ann_reader_t));
+    for(int i = 0; i < max_readers; i++) {
+        atomic_init(&handle->readers[i].epoch, READER_IDLE);
+        handle->readers[i].snapshot = NULL;
+    }
+
+    //epoch 0 is reserved to mark idle readers
+    atomic_init(&handle->epoch, 1);
+    atomic_init(&handle->reader_cnt, 0);
+    atomic_init(&handle->current, ann_snapshot_create(initial));
+
+    handle->retired_cnt = 0;
+    handle->retired_cap = 4;
+    handle->retired = malloc(handle->retired_cap * sizeof(ann_snapshot_t*));
+
+    return handle;
+}
+
+int ann_handle_register(ann_handle_t *handle) {
+    int idx = atomic_fetch_add(&handle->reader_cnt, 1);
+    if(idx >= handle->max_readers)
+        return -1;
+    return idx;
+}
+
+ann_t ann_handle_acquire(ann_handle_t *handle, int reader) {
+    ann_reader_t *r = &handle->readers[reader];
+
+    //announce the epoch before looking at the pointer, any snapshot retired
+    //after this point can't be freed until we release
+    atomic_store(&r->epoch, atomic_load(&handle->epoch));
+    r->snapshot = atomic_load(&handle->current);
+
+    return r->snapshot->ann;
+}
+
+void ann_handle_release(ann_handle_t *handle, int reader) {
+    ann_reader_t *r = &handle->readers[reader];
+    r->snapshot = NULL;
+    atomic_store_explicit(&r->epoch, READER_IDLE, memory_order_release);
+}
+
+int ann_handle_activate(ann_handle_t *handle, int reader, float* inputs, float* outputs) {
+    ann_t ann = ann_handle_acquire(handle, reader);
+    int ret = ann_activate(ann, inputs, outputs);
+    ann_handle_release(handle, reader);
+    return ret;
+}
+
+void ann_handle_publish(ann_handle_t *handle, ann_t ann) {
+    ann_snapshot_t *snap = ann_snapshot_create(ann);
+    ann_snapshot_t *old = atomic_exchange(&handle->current, snap);
+
+    //readers that announced an epoch <= retire_epoch may still hold old,
+    //readers arriving after the increment are guaranteed to see snap
+    old->retire_epoch = atomic_fetch_add(&handle->epoch, 1);
+
+    if(handle->retired_cnt == handle->retired_cap) {
+        handle->retired_cap *= 2;
+        handle->retired = realloc(handle->retired, handle->retired_cap * sizeof(ann_snapshot_t*));
+    }
+    handle->retired[handle->retired_cnt++] = old;
+
+    ann_handle_reclaim(handle);
+}
+
+int ann_handle_reclaim(ann_handle_t *handle) {
+    //find the oldest epoch any reader is still inside
+    unsigned long min_epoch = atomic_load(&handle->epoch);
+    int reader_cnt = atomic_load(&handle->reader_cnt);
+    if(reader_cnt > handle->max_readers)
+        reader_cnt = handle->max_readers;
+
+    for(int i = 0; i < reader_cnt; i++) {
+        unsigned long e = atomic_load(&handle->readers[i].epoch);
+        if(e != READER_IDLE && e < min_epoch)
+            min_epoch = e;
+    }
+
+    int kept = 0;
+    for(int i = 0; i < handle->retired_cnt; i++) {
+        if(handle->retired[i]->retire_epoch < min_epoch)
+            ann_snapshot_delete(handle->retired[i]);
+        else
+            handle->retired[kept++] = handle->retired[i];
+    }
+    handle->retired_cnt = kept;
+
+    return kept;
+}
+
+void ann_handle_delete(ann_handle_t *handle) {
+    for(int i = 0; i < handle->retired_cnt; i++)
+        ann_snapshot_delete(handle->retired[i]);
+
+    ann_snapshot_delete(atomic_load(&handle->current));
+    free(handle->retired);
+    free(handle->readers);
+    free(handle);
+}
@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann_tune.h"
+#include "ann.h"
+#include "mat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define HOST_KEY_LEN 256
+#define TUNE_RUNS 3
+#define TUNE_FLOPS 20000000.0
+
+typedef struct tune_line tune_line_t;
+struct tune_line {
+    char host[HOST_KEY_LEN];
+    int width;
+    int height;
+    mat_tune_t tune;
+};
+
+//hostname plus cpu model, so a cache on a shared filesystem stays correct
+//across a mixed cluster
+static void tune_hostkey(char *key) {
+    char host[64] = "unknown";
+    char model[160] = "unknown";
+
+    gethostname(host, sizeof(host) - 1);
+
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if(f != NULL) {
+        char line[256];
+        while(fgets(line, sizeof(line), f) != NULL) {
+            if(strncmp(line, "model name", 10) != 0)
+                continue;
+
+            char *val = strchr(line, ':');
+            if(val != NULL) {
+                val++;
+                while(*val == ' ')
+                    val++;
+                strncpy(model, val, sizeof(model) - 1);
+                model[strcspn(model, "\n")] = 0;
+            }
+            break;
+        }
+        fclose(f);
+    }
+
+    snprintf(key, HOST_KEY_LEN, "%s/%s", host, model);
+    for(char *c = key; *c; c++)
+        if(*c == ' ' || *c == '\t')
+            *c = '_';
+}
+
+static tune_line_t* tune_readcache(const char *path, int *cnt) {
+    *cnt = 0;
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+        return NULL;
+
+    int cap = 16;
+    tune_line_t *lines = malloc(cap * sizeof(tune_line_t));
+    tune_line_t l;
+
+    while(fscanf(f, "%255s %d %d %d %d", l.host, &l.width, &l.height, &l.tune.strips, &l.tune.unroll) == 5) {
+        if(*cnt == cap) {
+            cap *= 2;
+            lines = realloc(lines, cap * sizeof(tune_line_t));
+        }
+        lines[(*cnt)++] = l;
+    }
+
+    fclose(f);
+    return lines;
+}
+
+//replaces the line for the same host and shape, or appends one. Later
+//duplicates left behind by older versions are dropped as well.
+static tune_line_t* tune_putline(tune_line_t *lines, int *cnt, tune_line_t *l) {
+    int found = 0;
+    int n = 0;
+    for(int i = 0; i < *cnt; i++) {
+        if(lines[i].width == l->width && lines[i].height == l->height && strcmp(lines[i].host, l->host) == 0) {
+            if(found)
+                continue;
+            lines[i].tune = l->tune;
+            found = 1;
+        }
+        lines[n++] = lines[i];
+    }
+    *cnt = n;
+
+    if(!found) {
+        lines = realloc(lines, (*cnt + 1) * sizeof(tune_line_t));
+        lines[(*cnt)++] = *l;
+    }
+    return lines;
+}
+
+//Several processes, possibly on different hosts, may share one cache file.
+//Hold a lock file while re-reading the cache and merging in the new lines
+//so nobody else's results are dropped, and write through a unique temp
+//file so a half written cache is never renamed into place.
+static int tune_writecache(const char *path, tune_line_t *fresh, int fresh_cnt) {
+    size_t len = strlen(path);
+    char *lock_path = malloc(len + 6);
+    char *tmp_path = malloc(len + 8);
+    memcpy(lock_path, path, len);
+    memcpy(lock_path + len, ".lock", 6);
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".XXXXXX", 8);
+
+    int ret = -1;
+    int lock_fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    if(lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0)
+        goto done;
+
+    int cnt = 0;
+    tune_line_t *lines = tune_readcache(path, &cnt);
+    for(int i = 0; i < fresh_cnt; i++)
+        lines = tune_putline(lines, &cnt, &fresh[i]);
+
+    int fd = mkstemp(tmp_path);
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "w");
+    if(f != NULL) {
+        ret = 0;
+        fchmod(fd, 0644);
+        for(int i = 0; i < cnt; i++)
+            if(fprintf(f, "%s %d %d %d %d\n", lines[i].host, lines[i].width, lines[i].height, lines[i].tune.strips, lines[i].tune.unroll) < 0)
+                ret = -1;
+        if(fclose(f) != 0)
+            ret = -1;
+        if(ret == 0 && rename(tmp_path, path) != 0)
+            ret = -1;
+        if(ret != 0)
+            remove(tmp_path);
+    } else if(fd >= 0) {
+        close(fd);
+        remove(tmp_path);
+    }
+    free(lines);
+
+done:
+    if(lock_fd >= 0)
+        close(lock_fd);
+    free(lock_path);
+    free(tmp_path);
+    return ret;
+}
+
+static double tune_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//times every variant on a w x h layer and returns the fastest
+static mat_tune_t tune_shape(int w, int h) {
+    mat_t a = mat_create(w, h);
+    mat_t b = mat_create(1, w);
+    mat_t d = mat_create(1, h);
+    mat_t c = mat_create(1, h);
+
+    for(int x = 0; x < w; x++) {
+        mat_set(b, 0, x, 1.0f / (x + 1));
+        for(int y = 0; y < h; y++)
+            mat_set(a, x, y, 0.001f * ((x + y) % 17));
+    }
+
+    int reps = (int)(TUNE_FLOPS / (2.0 * w * a.stride));
+    if(reps < 16)
+        reps = 16;
+
+    mat_tune_t best = mat_tunevariant(0);
+    double best_time = -1;
+
+    for(int v = 0; v < mat_tunecnt(); v++) {
+        //only the private scratch matrix is retuned, never a shared one
+        mat_tune_t tune = mat_tunevariant(v);
+        mat_settune(&a, tune);
+        mat_multadd(a, b, d, &c);
+
+        double t = -1;
+        for(int r = 0; r < TUNE_RUNS; r++) {
+            double start = tune_now();
+            for(int i = 0; i < reps; i++)
+                mat_multadd(a, b, d, &c);
+            double elapsed = tune_now() - start;
+
+            if(t < 0 || elapsed < t)
+                t = elapsed;
+        }
+
+        if(best_time < 0 || t < best_time) {
+            best_time = t;
+            best = tune;
+        }
+    }
+
+    mat_delete(a);
+    mat_delete(b);
+    mat_delete(c);
+    mat_delete(d);
+
+    return best;
+}
+
+int ann_autotune(ann_t ann, const char *cache_path) {
+    //small nets run on the ann_activate_small kernels and never reach
+    //mat_multadd, there's nothing worth tuning
+    if(ann.kernels != NULL)
+        return 0;
+
+    char host[HOST_KEY_LEN];
+    tune_hostkey(host);
+
+    if(cache_path == NULL)
+        cache_path = getenv("AILIB_TUNE_CACHE");
+
+    int cnt = 0;
+    tune_line_t *lines = NULL;
+    if(cache_path != NULL)
+        lines = tune_readcache(cache_path, &cnt);
+
+    int tuned = 0;
+    tune_line_t *fresh = NULL;
+    for(int i = 1; i < ann.layers; i++) {
+        int w = ann.weights[i].width;
+        int h = ann.weights[i].height;
+
+        int cached = 0;
+        for(int j = 0; j < cnt; j++)
+            if(lines[j].width == w && lines[j].height == h && strcmp(lines[j].host, host) == 0) {
+                cached = mat_settune(&ann.weights[i], lines[j].tune) == 0;
+                break;
+            }
+        if(cached)
+            continue;
+
+        //a stale line (unknown variant) is overwritten rather than shadowing
+        //the new result forever
+        tune_line_t l;
+        strcpy(l.host, host);
+        l.width = w;
+        l.height = h;
+        l.tune = tune_shape(w, h);
+        if(mat_settune(&ann.weights[i], l.tune) != 0) {
+            free(lines);
+            free(fresh);
+            return -1;
+        }
+
+        //lines keeps later layers of the same shape from re-benchmarking
+        lines = tune_putline(lines, &cnt, &l);
+        fresh = tune_putline(fresh, &tuned, &l);
+    }
+
+    //the lines read above may be out of date by now, only the new results
+    //are merged into the current file
+    int ret = tuned;
+    if(tuned > 0 && cache_path != NULL && tune_writecache(cache_path, fresh, tuned) != 0)
+        ret = -1;
+
+    free(lines);
+    free(fresh);
+    return ret;
+}
@@ -0,0 +1,353 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ckpt.h"
+#include "ann.h"
+#include "ga.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CKPT_MAGIC 0x434c4941
+#define CKPT_VERSION 2
+#define CKPT_NULL_MEMBER SIZE_MAX
+
+typedef struct ckpt_buf ckpt_buf_t;
+struct ckpt_buf {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+};
+
+struct ckpt {
+    char *path;
+    char *tmp_path;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    ckpt_buf_t bufs[2];
+    int pending;    //buffer waiting for the writer, -1 if none
+    int writing;    //buffer the writer owns, -1 if idle
+    int running;
+    int status;     //result of the last completed write
+};
+
+static void buf_reserve(ckpt_buf_t *buf, size_t extra) {
+    if(buf->len + extra <= buf->cap)
+        return;
+
+    while(buf->len + extra > buf->cap)
+        buf->cap = buf->cap == 0 ? 4096 : buf->cap * 2;
+    buf->data = realloc(buf->data, buf->cap);
+}
+
+static void buf_put(ckpt_buf_t *buf, const void *src, size_t sz) {
+    buf_reserve(buf, sz);
+    memcpy(buf->data + buf->len, src, sz);
+    buf->len += sz;
+}
+
+static int buf_get(const uint8_t **src, const uint8_t *end, void *dst, size_t sz) {
+    if((size_t)(end - *src) < sz)
+        return -1;
+    memcpy(dst, *src, sz);
+    *src += sz;
+    return 0;
+}
+
+static void ckpt_fill(ckpt_buf_t *buf, ann_t *nets, int net_cnt, ga_t *ga, MemberSave save) {
+    uint32_t magic = CKPT_MAGIC;
+    uint32_t version = CKPT_VERSION;
+    ann_rng_t ann_rng = ann_getrng();
+    ga_rng_t ga_rng = ga_getrng();
+    int has_ga = ga != NULL;
+
+    buf->len = 0;
+    buf_put(buf, &magic, sizeof(magic));
+    buf_put(buf, &version, sizeof(version));
+    buf_put(buf, &ann_rng, sizeof(ann_rng));
+    buf_put(buf, &ga_rng, sizeof(ga_rng));
+
+    buf_put(buf, &net_cnt, sizeof(int));
+    for(int i = 0; i < net_cnt; i++) {
+        size_t sz = ann_serialize(nets[i], NULL);
+        buf_put(buf, &sz, sizeof(sz));
+        buf_reserve(buf, sz);
+        buf->len += ann_serialize(nets[i], buf->data + buf->len);
+    }
+
+    buf_put(buf, &has_ga, sizeof(int));
+    if(!has_ga)
+        return;
+
+    buf_put(buf, &ga->pop_sz, sizeof(int));
+    buf_put(buf, &ga->generation, sizeof(int));
+    buf_put(buf, &ga->current_pop_sz, sizeof(int));
+    buf_put(buf, &ga->mutation_rate, sizeof(float));
+    buf_put(buf, ga->fitness_vals, ga->pop_sz * sizeof(float));
+
+    for(int i = 0; i < ga->pop_sz; i++) {
+        size_t sz = CKPT_NULL_MEMBER;
+        if(ga->population[i] == NULL) {
+            buf_put(buf, &sz, sizeof(sz));
+            continue;
+        }
+
+        sz = save(ga->population[i], NULL);
+        buf_put(buf, &sz, sizeof(sz));
+        buf_reserve(buf, sz);
+        buf->len += save(ga->population[i], buf->data + buf->len);
+    }
+}
+
+static int ckpt_write(ckpt_t *ckpt, ckpt_buf_t *buf) {
+    FILE *f = fopen(ckpt->tmp_path, "wb");
+    if(f == NULL)
+        return -1;
+
+    int ret = 0;
+    if(fwrite(buf->data, 1, buf->len, f) != buf->len)
+        ret = -1;
+    if(fflush(f) != 0 || fsync(fileno(f)) != 0)
+        ret = -1;
+    if(fclose(f) != 0)
+        ret = -1;
+
+    //only replace the previous checkpoint once the new one is on disk
+    if(ret == 0 && rename(ckpt->tmp_path, ckpt->path) != 0)
+        ret = -1;
+    if(ret != 0)
+        remove(ckpt->tmp_path);
+
+    return ret;
+}
+
+static void* ckpt_worker(void *arg) {
+    ckpt_t *ckpt = arg;
+
+    pthread_mutex_lock(&ckpt->lock);
+    while(1) {
+        while(ckpt->pending < 0 && ckpt->running)
+            pthread_cond_wait(&ckpt->cond, &ckpt->lock);
+        if(ckpt->pending < 0)
+            break;
+
+        int idx = ckpt->pending;
+        ckpt->pending = -1;
+        ckpt->writing = idx;
+        pthread_mutex_unlock(&ckpt->lock);
+
+        int status = ckpt_write(ckpt, &ckpt->bufs[idx]);
+
+        pthread_mutex_lock(&ckpt->lock);
+        ckpt->writing = -1;
+        ckpt->status = status;
+        pthread_cond_broadcast(&ckpt->cond);
+    }
+    pthread_mutex_unlock(&ckpt->lock);
+
+    return NULL;
+}
+
+ckpt_t* ckpt_create(const char *path) {
+    ckpt_t *ckpt = calloc(1, sizeof(ckpt_t));
+
+    size_t len = strlen(path);
+    ckpt->path = malloc(len + 1);
+    ckpt->tmp_path = malloc(len + 5);
+    memcpy(ckpt->path, path, len + 1);
+    memcpy(ckpt->tmp_path, path, len);
+    memcpy(ckpt->tmp_path + len, ".tmp", 5);
+
+    ckpt->pending = -1;
+    ckpt->writing = -1;
+    ckpt->running = 1;
+    ckpt->status = 0;
+    pthread_mutex_init(&ckpt->lock, NULL);
+    pthread_cond_init(&ckpt->cond, NULL);
+
+    if(pthread_create(&ckpt->thread, NULL, ckpt_worker, ckpt) != 0) {
+        pthread_mutex_destroy(&ckpt->lock);
+        pthread_cond_destroy(&ckpt->cond);
+        free(ckpt->path);
+        free(ckpt->tmp_path);
+        free(ckpt);
+        return NULL;
+    }
+
+    return ckpt;
+}
+
+int ckpt_save(ckpt_t *ckpt, ann_t *nets, int net_cnt, ga_t *ga, MemberSave save) {
+    //reuse a snapshot the writer hasn't picked up yet, otherwise take the
+    //buffer it isn't writing, the lock is never held while copying
+    pthread_mutex_lock(&ckpt->lock);
+    int idx = ckpt->pending;
+    if(idx < 0)
+        idx = ckpt->writing == 0 ? 1 : 0;
+    ckpt->pending = -1;
+    pthread_mutex_unlock(&ckpt->lock);
+
+    ckpt_fill(&ckpt->bufs[idx], nets, net_cnt, ga, save);
+
+    pthread_mutex_lock(&ckpt->lock);
+    ckpt->pending = idx;
+    pthread_cond_broadcast(&ckpt->cond);
+    pthread_mutex_unlock(&ckpt->lock);
+
+    return 0;
+}
+
+int ckpt_wait(ckpt_t *ckpt) {
+    pthread_mutex_lock(&ckpt->lock);
+    while(ckpt->pending >= 0 || ckpt->writing >= 0)
+        pthread_cond_wait(&ckpt->cond, &ckpt->lock);
+    int status = ckpt->status;
+    pthread_mutex_unlock(&ckpt->lock);
+
+    return status;
+}
+
+int ckpt_delete(ckpt_t *ckpt) {
+    pthread_mutex_lock(&ckpt->lock);
+    ckpt->running = 0;
+    pthread_cond_broadcast(&ckpt->cond);
+    pthread_mutex_unlock(&ckpt->lock);
+
+    //the worker drains any pending snapshot before exiting
+    pthread_join(ckpt->thread, NULL);
+    int status = ckpt->status;
+
+    pthread_mutex_destroy(&ckpt->lock);
+    pthread_cond_destroy(&ckpt->cond);
+    free(ckpt->bufs[0].data);
+    free(ckpt->bufs[1].data);
+    free(ckpt->path);
+    free(ckpt->tmp_path);
+    free(ckpt);
+
+    return status;
+}
+
+static int ckpt_parse(const uint8_t *src, const uint8_t *end, ann_t *nets, int net_cnt, ga_t *ga, MemberLoad load) {
+    uint32_t magic, version;
+    ann_rng_t ann_rng;
+    ga_rng_t ga_rng;
+    int file_net_cnt, has_ga;
+
+    if(buf_get(&src, end, &magic, sizeof(magic)) || magic != CKPT_MAGIC)
+        return -1;
+    if(buf_get(&src, end, &version, sizeof(version)) || version != CKPT_VERSION)
+        return -1;
+    if(buf_get(&src, end, &ann_rng, sizeof(ann_rng)) || buf_get(&src, end, &ga_rng, sizeof(ga_rng)))
+        return -1;
+    if(buf_get(&src, end, &file_net_cnt, sizeof(int)) || file_net_cnt != net_cnt)
+        return -1;
+
+    int loaded = 0;
+    for(; loaded < net_cnt; loaded++) {
+        size_t sz;
+        if(buf_get(&src, end, &sz, sizeof(sz)) || (size_t)(end - src) < sz)
+            goto fail;
+        if(ann_deserialize((void*)src, sz, &nets[loaded]) != 0)
+            goto fail;
+        src += sz;
+    }
+
+    if(buf_get(&src, end, &has_ga, sizeof(int)) || has_ga != (ga != NULL))
+        goto fail;
+
+    if(has_ga) {
+        int pop_sz;
+        if(buf_get(&src, end, &pop_sz, sizeof(int)) || pop_sz != ga->pop_sz)
+            goto fail;
+
+        int generation, current_pop_sz;
+        float mutation_rate;
+        float *fitness_vals = malloc(pop_sz * sizeof(float));
+        void **population = calloc(pop_sz, sizeof(void*));
+
+        if(buf_get(&src, end, &generation, sizeof(int)) ||
+           buf_get(&src, end, &current_pop_sz, sizeof(int)) ||
+           buf_get(&src, end, &mutation_rate, sizeof(float)) ||
+           buf_get(&src, end, fitness_vals, pop_sz * sizeof(float)))
+            goto fail_ga;
+
+        for(int i = 0; i < pop_sz; i++) {
+            size_t sz;
+            if(buf_get(&src, end, &sz, sizeof(sz)))
+                goto fail_ga;
+            if(sz == CKPT_NULL_MEMBER)
+                continue;
+            if((size_t)(end - src) < sz)
+                goto fail_ga;
+            population[i] = load((void*)src, sz);
+            src += sz;
+        }
+
+        //everything parsed, swap the restored population in
+        for(int i = 0; i < ga->pop_sz; i++)
+            if(ga->population[i] != NULL)
+                ga->murderer(ga->population[i]);
+
+        memcpy(ga->population, population, pop_sz * sizeof(void*));
+        memcpy(ga->fitness_vals, fitness_vals, pop_sz * sizeof(float));
+        ga->generation = generation;
+        ga->current_pop_sz = current_pop_sz;
+        ga->mutation_rate = mutation_rate;
+        free(population);
+        free(fitness_vals);
+        goto done;
+
+fail_ga:
+        for(int i = 0; i < pop_sz; i++)
+            if(population[i] != NULL)
+                ga->murderer(population[i]);
+        free(population);
+        free(fitness_vals);
+        goto fail;
+    }
+
+done:
+    ann_setrng(ann_rng);
+    ga_setrng(ga_rng);
+    return 0;
+
+fail:
+    for(int i = 0; i < loaded; i++)
+        ann_delete(nets[i]);
+    return -1;
+}
+
+int ckpt_load(const char *path, ann_t *nets, int net_cnt, ga_t *ga, MemberLoad load) {
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+        return -1;
+
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if(len <= 0) {
+        fclose(f);
+        return -1;
+    }
+
+    uint8_t *data = malloc(len);
+    size_t read = fread(data, 1, len, f);
+    fclose(f);
+
+    int ret = -1;
+    if(read == (size_t)len)
+        ret = ckpt_parse(data, data + len, nets, net_cnt, ga, load);
+
+    free(data);
+    return ret;
+}
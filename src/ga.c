@@ -7,11 +7,12 @@
 
 #include "ga.h"
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <math.h>
 
 static unsigned int seed = 0;
-#define CORNER_CNT 8
+#define CORNER_CNT GA_RNG_CORNERS
 static float corners[CORNER_CNT];
 static int prev_idx = 0;
 
@@ -37,6 +38,20 @@ void ga_setseed(unsigned int s) {
         ga_rand();
 }
 
+ga_rng_t ga_getrng(void) {
+    ga_rng_t rng;
+    rng.seed = seed;
+    rng.prev_idx = prev_idx;
+    memcpy(rng.corners, corners, sizeof(corners));
+    return rng;
+}
+
+void ga_setrng(ga_rng_t rng) {
+    seed = rng.seed;
+    prev_idx = rng.prev_idx;
+    memcpy(corners, rng.corners, sizeof(corners));
+}
+
 ga_t ga_create(int pop_sz, float mutation_rate, MemberIniter init, FitnessFunction fitness, MemberMutate mutator, MemberMerge merger, MemberKill murderer) {
     ga_t ga;
     ga.pop_sz = pop_sz;
@@ -10,7 +10,23 @@
 #include <x86intrin.h>
 #include "mat.h"
 
+static _Thread_local const mat_allocator_t *cur_allocator = NULL;
+
+void mat_setallocator(const mat_allocator_t *allocator) {
+    cur_allocator = allocator;
+}
+
+const mat_allocator_t* mat_getallocator(void) {
+    if(cur_allocator == NULL)
+        return &mat_allocator_default;
+    return cur_allocator;
+}
+
 mat_t mat_create(int width, int height) {
+    return mat_create_alloc(width, height, mat_getallocator());
+}
+
+mat_t mat_create_alloc(int width, int height, const mat_allocator_t *allocator) {
     mat_t nmat;
 
     nmat.width = width;
@@ -19,20 +35,23 @@ mat_t mat_create(int width, int height) {
     if(nmat.stride % 8 != 0)
         nmat.stride += (8 - nmat.stride % 8);
 
-    size_t alloc_sz = width * nmat.stride * sizeof(float);
+    size_t alloc_sz = (size_t)width * nmat.stride * sizeof(float);
     
     if(alloc_sz % 32 != 0)
         alloc_sz += (32 - alloc_sz % 32);
 
     nmat.alloc_sz = alloc_sz;
-    nmat.data = aligned_alloc(32, alloc_sz);
-    memset(nmat.data, 0, alloc_sz);
+    nmat.allocator = allocator;
+    nmat.variant = 0;
+    nmat.data = allocator->alloc(alloc_sz, allocator->ctx);
+    if(!allocator->zeroed)
+        memset(nmat.data, 0, alloc_sz);
 
     return nmat;
 }
 
 void mat_delete(mat_t mat) {
-    free(mat.data);
+    mat.allocator->free(mat.data, mat.alloc_sz, mat.allocator->ctx);
 }
 
 void mat_set(mat_t mat, int x, int y, float val) {
@@ -47,6 +66,92 @@ void mat_clear(mat_t mat) {
     memset(mat.data, 0, mat.alloc_sz);
 }
 
+//Matrix-vector kernel variants for the autotuner. strips is how many 8 row
+//strips share each broadcast of b, unroll how many independent accumulators
+//each strip uses. Strips left over at the bottom use a single strip. The
+//variant lives in the mat_t it applies to, so there's no shared state.
+typedef void (*mat_kernel_t)(const float*, int, int, const float*, const float*, float*);
+
+static inline __attribute__((always_inline)) void mat_kernel_block(const float *a, int stride, int width, const float *b, const float *d, float *c, const int strips, const int unroll) {
+    __m256 acc[4][8];
+
+    for(int s = 0; s < strips; s++)
+        for(int u = 0; u < unroll; u++)
+            acc[s][u] = (u == 0 && d != NULL) ? _mm256_load_ps(d + 8 * s) : _mm256_setzero_ps();
+
+    int x = 0;
+    for(; x + unroll <= width; x += unroll) {
+        for(int u = 0; u < unroll; u++) {
+            __m256 b_v = _mm256_set1_ps(b[x + u]);
+            for(int s = 0; s < strips; s++)
+                acc[s][u] = _mm256_fmadd_ps(_mm256_load_ps(a + stride * (x + u) + 8 * s), b_v, acc[s][u]);
+        }
+    }
+    for(; x < width; x++) {
+        __m256 b_v = _mm256_set1_ps(b[x]);
+        for(int s = 0; s < strips; s++)
+            acc[s][0] = _mm256_fmadd_ps(_mm256_load_ps(a + stride * x + 8 * s), b_v, acc[s][0]);
+    }
+
+    for(int s = 0; s < strips; s++) {
+        for(int u = 1; u < unroll; u++)
+            acc[s][0] = _mm256_add_ps(acc[s][0], acc[s][u]);
+        _mm256_store_ps(c + 8 * s, acc[s][0]);
+    }
+}
+
+#define MAT_KERNEL(S, U) \
+static void mat_kernel_##S##x##U(const float *a, int stride, int width, const float *b, const float *d, float *c) { \
+    int j = 0; \
+    for(; j + 8 * S <= stride; j += 8 * S) \
+        mat_kernel_block(a + j, stride, width, b, d ? d + j : NULL, c + j, S, U); \
+    for(; j < stride; j += 8) \
+        mat_kernel_block(a + j, stride, width, b, d ? d + j : NULL, c + j, 1, U); \
+}
+
+MAT_KERNEL(1, 2) MAT_KERNEL(1, 8)
+MAT_KERNEL(2, 2) MAT_KERNEL(2, 4)
+MAT_KERNEL(4, 1) MAT_KERNEL(4, 2) MAT_KERNEL(4, 3)
+
+typedef struct mat_variant mat_variant_t;
+struct mat_variant {
+    mat_tune_t tune;
+    mat_kernel_t kernel;    //NULL for the built-in kernel
+};
+
+static const mat_variant_t variants[] = {
+    { {1, 4}, NULL },
+    { {1, 2}, mat_kernel_1x2 },
+    { {1, 8}, mat_kernel_1x8 },
+    { {2, 2}, mat_kernel_2x2 },
+    { {2, 4}, mat_kernel_2x4 },
+    { {4, 1}, mat_kernel_4x1 },
+    { {4, 2}, mat_kernel_4x2 },
+    { {4, 3}, mat_kernel_4x3 },
+};
+#define VARIANT_CNT (int)(sizeof(variants) / sizeof(variants[0]))
+
+int mat_tunecnt(void) {
+    return VARIANT_CNT;
+}
+
+mat_tune_t mat_tunevariant(int idx) {
+    return variants[idx].tune;
+}
+
+int mat_settune(mat_t *mat, mat_tune_t tune) {
+    for(int i = 0; i < VARIANT_CNT; i++)
+        if(variants[i].tune.strips == tune.strips && variants[i].tune.unroll == tune.unroll) {
+            mat->variant = i;
+            return 0;
+        }
+    return -1;
+}
+
+mat_tune_t mat_gettune(mat_t mat) {
+    return variants[mat.variant].tune;
+}
+
 int mat_mult(mat_t a, mat_t b, mat_t *c) {
     if(a.width != b.height)
         return -1;
@@ -56,6 +161,14 @@ int mat_mult(mat_t a, mat_t b, mat_t *c) {
         return 0;
     }
 
+    if(b.width == 1) {
+        mat_kernel_t kernel = variants[a.variant].kernel;
+        if(kernel != NULL) {
+            kernel(a.data, a.stride, a.width, b.data, NULL, c->data);
+            return 0;
+        }
+    }
+
     //matrix multiplication
     for(int q = 0; q < b.width; q++){
         for(int j = 0; j < a.stride; j+= 8){
@@ -105,11 +218,16 @@ int mat_multadd(mat_t a, mat_t b, mat_t d, mat_t *c) {
         return -1;
 
     if(a.width == 1 && a.height == 1){
-        mat_set(*c, 0, 0, mat_get(a, 0, 0) * mat_get(b, 0, 0));
+        mat_set(*c, 0, 0, mat_get(a, 0, 0) * mat_get(b, 0, 0) + mat_get(d, 0, 0));
         return 0;
     }
 
     if(b.width == 1) {  //Vector and matrix multiplication
+        mat_kernel_t kernel = variants[a.variant].kernel;
+        if(kernel != NULL) {
+            kernel(a.data, a.stride, a.width, b.data, d.data, c->data);
+            return 0;
+        }
 
         for(int j = 0; j < a.stride; j+= 8){
 
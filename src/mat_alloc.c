@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "mat.h"
+
+#define HUGE_PAGE_SZ (2 * 1024 * 1024)
+
+//below this size mmap wastes more than it saves, use the heap instead
+#define LAZY_MIN_SZ (64 * 1024)
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << 26)
+#endif
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+
+static size_t round_up(size_t sz, size_t align) {
+    return (sz + align - 1) / align * align;
+}
+
+static void* heap_alloc(size_t sz, void *ctx) {
+    return aligned_alloc(32, sz);
+}
+
+static void* heap_alloc_zeroed(size_t sz) {
+    void *ptr = aligned_alloc(32, sz);
+    memset(ptr, 0, sz);
+    return ptr;
+}
+
+static void heap_free(void *ptr, size_t sz, void *ctx) {
+    free(ptr);
+}
+
+const mat_allocator_t mat_allocator_default = { heap_alloc, heap_free, 0, NULL };
+
+//Anonymous mappings are zero filled by the kernel on first touch, so there
+//is no need to memset them and the pages land wherever they're first used.
+static void* lazy_alloc(size_t sz, void *ctx) {
+    if(sz < LAZY_MIN_SZ)
+        return heap_alloc_zeroed(sz);
+
+    void *ptr = mmap(NULL, round_up(sz, getpagesize()), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED)
+        return NULL;
+    return ptr;
+}
+
+static void lazy_free(void *ptr, size_t sz, void *ctx) {
+    if(sz < LAZY_MIN_SZ)
+        free(ptr);
+    else
+        munmap(ptr, round_up(sz, getpagesize()));
+}
+
+const mat_allocator_t mat_allocator_lazy = { lazy_alloc, lazy_free, 1, NULL };
+
+//Map with an extra huge page of slack and trim it so the region starts on a
+//2MB boundary, otherwise THP can't back the head of the allocation.
+static void* thp_map(size_t len) {
+    size_t map_len = len + HUGE_PAGE_SZ;
+    uint8_t *base = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED)
+        return NULL;
+
+    uint8_t *aligned = (uint8_t*)round_up((uintptr_t)base, HUGE_PAGE_SZ);
+    if(aligned != base)
+        munmap(base, aligned - base);
+    if(base + map_len != aligned + len)
+        munmap(aligned + len, (base + map_len) - (aligned + len));
+
+    madvise(aligned, len, MADV_HUGEPAGE);
+    return aligned;
+}
+
+static void* thp_alloc(size_t sz, void *ctx) {
+    if(sz < HUGE_PAGE_SZ / 2)
+        return heap_alloc_zeroed(sz);
+    return thp_map(round_up(sz, HUGE_PAGE_SZ));
+}
+
+static void huge_free(void *ptr, size_t sz, void *ctx) {
+    if(sz < HUGE_PAGE_SZ / 2)
+        free(ptr);
+    else
+        munmap(ptr, round_up(sz, HUGE_PAGE_SZ));
+}
+
+const mat_allocator_t mat_allocator_thp = { thp_alloc, huge_free, 1, NULL };
+
+//Explicit huge pages need a reserved hugetlbfs pool, fall back to THP when
+//the pool is empty or missing.
+static void* hugetlb_alloc(size_t sz, void *ctx) {
+    if(sz < HUGE_PAGE_SZ / 2)
+        return heap_alloc_zeroed(sz);
+
+    size_t len = round_up(sz, HUGE_PAGE_SZ);
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+    if(ptr == MAP_FAILED)
+        return thp_map(len);
+    return ptr;
+}
+
+const mat_allocator_t mat_allocator_hugetlb = { hugetlb_alloc, huge_free, 1, NULL };
+
+//ctx holds the node + 1, 0 meaning whichever node first touches the pages.
+//The mapping isn't touched here so the policy applies to every page.
+static void* numa_alloc(size_t sz, void *ctx) {
+    if(sz < LAZY_MIN_SZ)
+        return heap_alloc_zeroed(sz);
+
+    size_t len = round_up(sz, getpagesize());
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED)
+        return NULL;
+
+    int node = (int)(intptr_t)ctx - 1;
+    if(node < 0) {
+        syscall(SYS_mbind, ptr, len, MPOL_LOCAL, NULL, 0, 0);
+    } else {
+        unsigned long mask[16] = {0};
+        if(node < (int)(sizeof(mask) * 8)) {
+            mask[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+            syscall(SYS_mbind, ptr, len, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0);
+        }
+    }
+
+    return ptr;
+}
+
+//mat_t keeps a pointer to its allocator, so hand out entries of a static
+//table instead of values that could go out of scope
+#define NUMA_ENTRY(n) { numa_alloc, lazy_free, 1, (void*)(intptr_t)(n) }
+#define NUMA_ENTRY8(n) NUMA_ENTRY(n), NUMA_ENTRY(n + 1), NUMA_ENTRY(n + 2), NUMA_ENTRY(n + 3), \
+                       NUMA_ENTRY(n + 4), NUMA_ENTRY(n + 5), NUMA_ENTRY(n + 6), NUMA_ENTRY(n + 7)
+
+static const mat_allocator_t numa_allocators[MAT_NUMA_MAX_NODES + 1] = {
+    NUMA_ENTRY(0),
+    NUMA_ENTRY8(1),  NUMA_ENTRY8(9),  NUMA_ENTRY8(17), NUMA_ENTRY8(25),
+    NUMA_ENTRY8(33), NUMA_ENTRY8(41), NUMA_ENTRY8(49), NUMA_ENTRY8(57),
+};
+
+const mat_allocator_t* mat_allocator_numa(int node) {
+    if(node >= MAT_NUMA_MAX_NODES)
+        return NULL;
+    return &numa_allocators[node < 0 ? 0 : node + 1];
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann_bank.h"
+#include "ann.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define LAYERS 4
+#define MODELS 13
+#define MAX_W 8
+
+static int sizes[LAYERS] = {3, 5, 4, 2};
+
+//plain scalar per-sample SGD, what ann_bank_train is expected to compute
+static void ref_train(ann_t n, float* input, float* expected) {
+    float a[LAYERS][MAX_W], z[LAYERS][MAX_W], d[LAYERS][MAX_W];
+
+    for(int x = 0; x < sizes[0]; x++)
+        a[0][x] = input[x];
+
+    for(int i = 1; i < LAYERS; i++)
+        for(int y = 0; y < sizes[i]; y++) {
+            float s = mat_get(n.biases[i], 0, y);
+            for(int x = 0; x < sizes[i - 1]; x++)
+                s += mat_get(n.weights[i], x, y) * a[i - 1][x];
+            z[i][y] = s;
+            a[i][y] = s > 0 ? s : 0;
+        }
+
+    for(int y = 0; y < sizes[LAYERS - 1]; y++)
+        d[LAYERS - 1][y] = (a[LAYERS - 1][y] - expected[y]) * (z[LAYERS - 1][y] > 0);
+
+    for(int i = LAYERS - 1; i > 0; i--) {
+        if(i > 1)
+            for(int x = 0; x < sizes[i - 1]; x++) {
+                float s = 0;
+                for(int y = 0; y < sizes[i]; y++)
+                    s += mat_get(n.weights[i], x, y) * d[i][y];
+                d[i - 1][x] = s * (z[i - 1][x] > 0);
+            }
+
+        for(int y = 0; y < sizes[i]; y++) {
+            mat_set(n.biases[i], 0, y, mat_get(n.biases[i], 0, y) - n.learning_rate * d[i][y]);
+            for(int x = 0; x < sizes[i - 1]; x++)
+                mat_set(n.weights[i], x, y, mat_get(n.weights[i], x, y) - n.learning_rate * d[i][y] * a[i - 1][x]);
+        }
+    }
+}
+
+int main() {
+    int failed = 0;
+    float rates[MODELS];
+    for(int k = 0; k < MODELS; k++)
+        rates[k] = 0.01f * (k + 1);
+
+    ann_setseed(5);
+    ann_bank_t bank = ann_bank_create(MODELS, LAYERS, sizes, rates);
+
+    //reading a model out must not disturb the rng
+    ann_rng_t before = ann_getrng();
+    ann_t nets[MODELS];
+    for(int k = 0; k < MODELS; k++)
+        nets[k] = ann_bank_getmodel(bank, k);
+    ann_rng_t after = ann_getrng();
+    if(memcmp(&before, &after, sizeof(ann_rng_t)) != 0) {
+        printf("ann_bank_getmodel changed the rng\r\n");
+        failed = 1;
+    }
+
+    for(int it = 0; it < 2000; it++) {
+        float in[3] = {(it % 3) * 0.5f, (it % 5) * 0.3f, 1};
+        float out[2] = {in[0] + in[1], in[0] * 0.5f};
+
+        ann_bank_train(bank, in, out);
+        for(int k = 0; k < MODELS; k++)
+            ref_train(nets[k], in, out);
+    }
+
+    float in[3] = {0.5f, 0.3f, 1};
+    float outputs[MODELS * 2], mean[2], res[2];
+    float avg[2] = {0, 0};
+    float max_diff = 0;
+
+    ann_bank_activate(bank, in, outputs);
+    ann_bank_activate_mean(bank, in, mean);
+
+    for(int k = 0; k < MODELS; k++) {
+        ann_activate(nets[k], in, res);
+        for(int y = 0; y < 2; y++) {
+            max_diff = fmaxf(max_diff, fabsf(res[y] - outputs[k * 2 + y]));
+            avg[y] += outputs[k * 2 + y] / MODELS;
+        }
+    }
+
+    if(max_diff > 1e-5f) {
+        printf("bank differs from reference by %f\r\n", max_diff);
+        failed = 1;
+    }
+
+    if(fabsf(avg[0] - mean[0]) > 1e-5f || fabsf(avg[1] - mean[1]) > 1e-5f) {
+        printf("ensemble mean mismatch\r\n");
+        failed = 1;
+    }
+
+    int one_layer[1] = {3};
+    ann_bank_t flat = ann_bank_create(2, 1, one_layer, rates);
+    if(ann_bank_train(flat, in, in) != -1) {
+        printf("single layer bank accepted training\r\n");
+        failed = 1;
+    }
+    ann_bank_delete(flat);
+
+    for(int k = 0; k < MODELS; k++)
+        ann_delete(nets[k]);
+    ann_bank_delete(bank);
+
+    return failed;
+}
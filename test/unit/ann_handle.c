@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann_handle.h"
+#include "ann.h"
+
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define READERS 4
+#define PUBLISHES 20000
+
+static ann_handle_t *handle;
+static atomic_int stop;
+static atomic_int errors;
+
+//every weight and bias of generation g holds the value g, so a reader can
+//tell a torn or freed snapshot from a consistent one
+static void fill(ann_t ann, float val) {
+    for(int i = 1; i < ann.layers; i++) {
+        for(int x = 0; x < ann.weights[i].width; x++)
+            for(int y = 0; y < ann.weights[i].height; y++)
+                mat_set(ann.weights[i], x, y, val);
+        for(int y = 0; y < ann.biases[i].height; y++)
+            mat_set(ann.biases[i], 0, y, val);
+    }
+}
+
+static void* reader(void *arg) {
+    int idx = ann_handle_register(handle);
+    float last = 0;
+    float in[3] = {1, 1, 1};
+    float out[3];
+
+    while(!atomic_load(&stop)) {
+        ann_t ann = ann_handle_acquire(handle, idx);
+        float val = mat_get(ann.weights[1], 0, 0);
+
+        for(int i = 1; i < ann.layers; i++)
+            for(int x = 0; x < ann.weights[i].width; x++)
+                for(int y = 0; y < ann.weights[i].height; y++)
+                    if(mat_get(ann.weights[i], x, y) != val || mat_get(ann.biases[i], 0, y) != val)
+                        atomic_fetch_add(&errors, 1);
+
+        if(val < last)
+            atomic_fetch_add(&errors, 1);
+        last = val;
+
+        ann_handle_release(handle, idx);
+
+        if(ann_handle_activate(handle, idx, in, out) != 0)
+            atomic_fetch_add(&errors, 1);
+    }
+
+    return NULL;
+}
+
+int main() {
+    int failed = 0;
+    int layers[] = {3, 20, 3};
+
+    ann_setseed(1);
+    ann_t net = ann_create(3, layers, 0.05);
+    fill(net, 0);
+    handle = ann_handle_create(net, READERS);
+
+    pthread_t threads[READERS];
+    for(int i = 0; i < READERS; i++)
+        pthread_create(&threads[i], NULL, reader, NULL);
+
+    for(int g = 1; g <= PUBLISHES; g++) {
+        fill(net, g);
+        ann_handle_publish(handle, net);
+    }
+
+    atomic_store(&stop, 1);
+    for(int i = 0; i < READERS; i++)
+        pthread_join(threads[i], NULL);
+
+    if(atomic_load(&errors) != 0) {
+        printf("%d inconsistent snapshot reads\r\n", atomic_load(&errors));
+        failed = 1;
+    }
+
+    if(ann_handle_register(handle) != -1) {
+        printf("registered more than max_readers\r\n");
+        failed = 1;
+    }
+
+    if(ann_handle_reclaim(handle) != 0) {
+        printf("retired snapshots left with no readers\r\n");
+        failed = 1;
+    }
+
+    float in[3] = {1, 1, 1};
+    float out[3], expected[3];
+    ann_activate(net, in, expected);
+    ann_t latest = ann_handle_acquire(handle, 0);
+    ann_activate(latest, in, out);
+    ann_handle_release(handle, 0);
+    for(int i = 0; i < 3; i++)
+        if(out[i] != expected[i]) {
+            printf("latest snapshot doesn't match the published net\r\n");
+            failed = 1;
+            break;
+        }
+
+    ann_handle_delete(handle);
+    ann_delete(net);
+
+    return failed;
+}
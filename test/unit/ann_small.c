@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ann.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SAMPLES 19
+#define MAX_W 16
+
+static int topo_1[] = {1, 1, 1};
+static int topo_2[] = {2, 2, 2};
+static int topo_3[] = {16, 9, 16, 3};
+static int topo_4[] = {5, 13, 7, 8};
+
+static int *topos[] = {topo_1, topo_2, topo_3, topo_4};
+static int topo_layers[] = {3, 3, 4, 4};
+
+static int close_enough(float a, float b) {
+    return fabsf(a - b) <= 1e-5f * (1 + fabsf(b));
+}
+
+//mixed signs with positive biases so the relu leaves most outputs nonzero
+static void fill(ann_t ann) {
+    for(int i = 1; i < ann.layers; i++)
+        for(int y = 0; y < ann.weights[i].height; y++) {
+            mat_set(ann.biases[i], 0, y, 0.1f + 0.02f * y);
+            for(int x = 0; x < ann.weights[i].width; x++)
+                mat_set(ann.weights[i], x, y, 0.3f * sinf(i * 7.0f + x * 1.3f + y * 0.7f));
+        }
+}
+
+static int check_topo(int layers, int *sizes) {
+    int failed = 0;
+    int in_sz = sizes[0];
+    int out_sz = sizes[layers - 1];
+
+    ann_t net = ann_create(layers, sizes, 0.1);
+    if(net.kernels == NULL) {
+        printf("{%d..%d} didn't pick the small kernels\r\n", in_sz, out_sz);
+        ann_delete(net);
+        return 1;
+    }
+    fill(net);
+
+    //same weights, forced onto the mat_multadd path
+    ann_t generic = ann_copy(net);
+    free(generic.kernels);
+    generic.kernels = NULL;
+
+    float inputs[SAMPLES * MAX_W];
+    float single[SAMPLES * MAX_W];
+    float batch[SAMPLES * MAX_W];
+    float ref[SAMPLES * MAX_W];
+
+    for(int i = 0; i < SAMPLES * in_sz; i++)
+        inputs[i] = 0.5f * cosf(i * 0.37f);
+
+    for(int s = 0; s < SAMPLES; s++) {
+        ann_activate(net, &inputs[s * in_sz], &single[s * out_sz]);
+        ann_activate(generic, &inputs[s * in_sz], &ref[s * out_sz]);
+    }
+
+    //19 samples leaves a partial last group of 3 lanes
+    ann_activate_batch(net, SAMPLES, inputs, batch);
+
+    int nonzero = 0;
+    for(int i = 0; i < SAMPLES * out_sz; i++) {
+        if(ref[i] != 0)
+            nonzero = 1;
+
+        if(!close_enough(single[i], ref[i])) {
+            printf("layers %d: ann_activate differs at sample %d output %d (%f vs %f)\r\n", layers, i / out_sz, i % out_sz, single[i], ref[i]);
+            failed = 1;
+            break;
+        }
+        if(!close_enough(batch[i], ref[i])) {
+            printf("layers %d: ann_activate_batch differs at sample %d output %d (%f vs %f)\r\n", layers, i / out_sz, i % out_sz, batch[i], ref[i]);
+            failed = 1;
+            break;
+        }
+    }
+
+    if(!nonzero) {
+        printf("{%d..%d} produced only zeros\r\n", in_sz, out_sz);
+        failed = 1;
+    }
+
+    ann_delete(net);
+    ann_delete(generic);
+
+    return failed;
+}
+
+int main() {
+    int failed = 0;
+
+    for(int i = 0; i < (int)(sizeof(topos) / sizeof(topos[0])); i++)
+        if(check_topo(topo_layers[i], topos[i]))
+            failed = 1;
+
+    //one layer over ANN_SMALL_MAX keeps the generic path
+    int big[] = {4, ANN_SMALL_MAX + 1, 2};
+    ann_t net = ann_create(3, big, 0.1);
+    if(net.kernels != NULL) {
+        printf("picked small kernels for a %d wide layer\r\n", ANN_SMALL_MAX + 1);
+        failed = 1;
+    }
+    ann_delete(net);
+
+    return failed;
+}
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "ckpt.h"
+#include "ann.h"
+#include "ga.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CKPT_PATH "ckpt_test.bin"
+#define BAD_PATH "ckpt_test_bad.bin"
+#define TUNED_PATH "ckpt_test_tuned.bin"
+#define POP_SZ 6
+
+static float train_in[4][2] = {{0, 0}, {1, 1}, {1, 0}, {0, 1}};
+static float train_out[4][2] = {{0, 0}, {0, 0}, {1, 1}, {1, 1}};
+
+static void* member_init(int id) {
+    float *f = malloc(sizeof(float));
+    *f = (id & 0xff) / 10.0f;
+    return f;
+}
+
+static float member_fitness(void *m) {
+    return *(float*)m;
+}
+
+static void member_kill(void *m) {
+    free(m);
+}
+
+static size_t member_save(void *m, void *buf) {
+    if(buf != NULL)
+        memcpy(buf, m, sizeof(float));
+    return sizeof(float);
+}
+
+static void* member_load(void *buf, size_t sz) {
+    float *f = malloc(sizeof(float));
+    memcpy(f, buf, sizeof(float));
+    return f;
+}
+
+static void train(ann_t net, int steps) {
+    for(int i = 0; i < steps; i++)
+        ann_train(net, train_in[i % 4], train_out[i % 4]);
+}
+
+static int nets_equal(ann_t a, ann_t b) {
+    if(a.layers != b.layers || a.learning_rate != b.learning_rate)
+        return 0;
+
+    for(int i = 1; i < a.layers; i++) {
+        if(memcmp(a.weights[i].data, b.weights[i].data, a.weights[i].alloc_sz) != 0)
+            return 0;
+        if(memcmp(a.biases[i].data, b.biases[i].data, a.biases[i].alloc_sz) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+//the tuned kernels sum in a different order than the default one, so the
+//resumed net has to come back with the same variants to stay bit exact
+static int tuned_resume(void) {
+    int failed = 0;
+    int layers[] = {40, 40, 40, 40};
+    float in[40], out[40];
+    for(int i = 0; i < 40; i++) {
+        in[i] = (i % 5) / 5.0f;
+        out[i] = (i % 3) / 3.0f;
+    }
+
+    ann_setseed(11);
+    ann_t net = ann_create(4, layers, 0.01);
+    mat_tune_t tune = { 4, 3 };
+    for(int i = 1; i < net.layers; i++)
+        mat_settune(&net.weights[i], tune);
+    for(int i = 0; i < 50; i++)
+        ann_train(net, in, out);
+
+    ckpt_t *ckpt = ckpt_create(TUNED_PATH);
+    ckpt_save(ckpt, &net, 1, NULL, NULL);
+    if(ckpt_delete(ckpt) != 0) {
+        printf("tuned checkpoint write failed\r\n");
+        ann_delete(net);
+        return 1;
+    }
+
+    for(int i = 0; i < 300; i++)
+        ann_train(net, in, out);
+
+    ann_t resumed;
+    if(ckpt_load(TUNED_PATH, &resumed, 1, NULL, NULL) != 0) {
+        printf("tuned checkpoint load failed\r\n");
+        ann_delete(net);
+        return 1;
+    }
+
+    for(int i = 1; i < resumed.layers; i++) {
+        mat_tune_t t = mat_gettune(resumed.weights[i]);
+        if(t.strips != tune.strips || t.unroll != tune.unroll) {
+            printf("layer %d resumed with a %dx%d kernel\r\n", i, t.strips, t.unroll);
+            failed = 1;
+        }
+    }
+
+    for(int i = 0; i < 300; i++)
+        ann_train(resumed, in, out);
+    if(!nets_equal(net, resumed)) {
+        printf("tuned resume is not bit exact\r\n");
+        failed = 1;
+    }
+
+    ann_delete(net);
+    ann_delete(resumed);
+    remove(TUNED_PATH);
+    return failed;
+}
+
+static long read_file(const char *path, unsigned char **data) {
+    FILE *f = fopen(path, "rb");
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *data = malloc(len);
+    if(fread(*data, 1, len, f) != (size_t)len)
+        len = -1;
+    fclose(f);
+    return len;
+}
+
+static void write_file(const char *path, unsigned char *data, long len) {
+    FILE *f = fopen(path, "wb");
+    fwrite(data, 1, len, f);
+    fclose(f);
+}
+
+int main() {
+    int failed = 0;
+
+    ann_setseed(7);
+    ga_setseed(3);
+
+    int layers[] = {2, 24, 24, 2};
+    ann_t net = ann_create(4, layers, 0.05);
+    ga_t ga = ga_create(POP_SZ, 0.1, member_init, member_fitness, NULL, NULL, member_kill);
+    train(net, 200);
+
+    ckpt_t *ckpt = ckpt_create(CKPT_PATH);
+    ckpt_save(ckpt, &net, 1, &ga, member_save);
+    if(ckpt_delete(ckpt) != 0) {
+        printf("checkpoint write failed\r\n");
+        return 1;
+    }
+
+    ann_rng_t saved_rng = ann_getrng();
+
+    //continue the original run
+    train(net, 500);
+
+    //resume from the checkpoint with a disturbed rng and population
+    ann_setseed(1234);
+    ga_t ga2 = ga_create(POP_SZ, 0.9, member_init, member_fitness, NULL, NULL, member_kill);
+    ann_t resumed;
+    if(ckpt_load(CKPT_PATH, &resumed, 1, &ga2, member_load) != 0) {
+        printf("checkpoint load failed\r\n");
+        return 1;
+    }
+
+    ann_rng_t loaded_rng = ann_getrng();
+    if(memcmp(&saved_rng, &loaded_rng, sizeof(ann_rng_t)) != 0) {
+        printf("rng not restored\r\n");
+        failed = 1;
+    }
+
+    train(resumed, 500);
+    if(!nets_equal(net, resumed)) {
+        printf("resumed training is not bit exact\r\n");
+        failed = 1;
+    }
+
+    if(ga2.mutation_rate != ga.mutation_rate || memcmp(ga.fitness_vals, ga2.fitness_vals, POP_SZ * sizeof(float)) != 0) {
+        printf("ga state not restored\r\n");
+        failed = 1;
+    }
+    for(int i = 0; i < POP_SZ; i++)
+        if(*(float*)ga.population[i] != *(float*)ga2.population[i]) {
+            printf("ga member %d not restored\r\n", i);
+            failed = 1;
+        }
+
+    //corrupt copies of the checkpoint must be rejected
+    unsigned char *data;
+    long len = read_file(CKPT_PATH, &data);
+    size_t layer_off = 2 * sizeof(unsigned int) + sizeof(ann_rng_t) + sizeof(ga_rng_t) + sizeof(int) + sizeof(size_t) + sizeof(int) + sizeof(float);
+    int bad_sizes[] = {1 << 29, 0, -5, 3};
+
+    for(int i = 0; i < 4; i++) {
+        unsigned char *bad = malloc(len);
+        memcpy(bad, data, len);
+        memcpy(bad + layer_off + sizeof(int), &bad_sizes[i], sizeof(int));
+        write_file(BAD_PATH, bad, len);
+        free(bad);
+
+        ann_t tmp;
+        if(ckpt_load(BAD_PATH, &tmp, 1, &ga2, member_load) == 0) {
+            printf("accepted layer size %d\r\n", bad_sizes[i]);
+            ann_delete(tmp);
+            failed = 1;
+        }
+    }
+
+    //an unknown kernel variant in the first weight layer
+    unsigned char *bad = malloc(len);
+    memcpy(bad, data, len);
+    mat_tune_t bad_tune = { 99, 1 };
+    memcpy(bad + layer_off + 4 * sizeof(int), &bad_tune, sizeof(mat_tune_t));
+    write_file(BAD_PATH, bad, len);
+    free(bad);
+
+    ann_t tmp;
+    if(ckpt_load(BAD_PATH, &tmp, 1, &ga2, member_load) == 0) {
+        printf("accepted unknown kernel variant\r\n");
+        ann_delete(tmp);
+        failed = 1;
+    }
+
+    data[0] ^= 0xff;
+    write_file(BAD_PATH, data, len);
+    if(ckpt_load(BAD_PATH, &tmp, 1, &ga2, member_load) == 0) {
+        printf("accepted bad magic\r\n");
+        failed = 1;
+    }
+    data[0] ^= 0xff;
+
+    write_file(BAD_PATH, data, len - 3);
+    if(ckpt_load(BAD_PATH, &tmp, 1, &ga2, member_load) == 0) {
+        printf("accepted truncated file\r\n");
+        failed = 1;
+    }
+
+    free(data);
+    remove(CKPT_PATH);
+    remove(BAD_PATH);
+    ann_delete(net);
+    ann_delete(resumed);
+
+    if(tuned_resume())
+        failed = 1;
+
+    return failed;
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "mat.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+//below the 64KB mmap threshold, between it and the 1MB huge page one, and
+//above both
+static int shapes[][2] = {{4, 8}, {100, 200}, {600, 1000}};
+
+static int alloc_cnt, free_cnt;
+
+static void* count_alloc(size_t sz, void *ctx) {
+    alloc_cnt++;
+    return aligned_alloc(32, sz);
+}
+
+static void count_free(void *ptr, size_t sz, void *ctx) {
+    free_cnt++;
+    free(ptr);
+}
+
+static const mat_allocator_t counting = { count_alloc, count_free, 0, NULL };
+
+static int check_backend(const char *name, const mat_allocator_t *allocator) {
+    int failed = 0;
+
+    for(int i = 0; i < (int)(sizeof(shapes) / sizeof(shapes[0])); i++) {
+        mat_t m = mat_create_alloc(shapes[i][0], shapes[i][1], allocator);
+        if(m.data == NULL) {
+            printf("%s: allocation of %zu bytes failed\r\n", name, m.alloc_sz);
+            failed = 1;
+            continue;
+        }
+
+        if((uintptr_t)m.data % 32 != 0) {
+            printf("%s: %zu bytes not 32 byte aligned\r\n", name, m.alloc_sz);
+            failed = 1;
+        }
+
+        float *f = m.data;
+        for(size_t j = 0; j < m.alloc_sz / sizeof(float); j++)
+            if(f[j] != 0) {
+                printf("%s: %zu bytes not zero filled\r\n", name, m.alloc_sz);
+                failed = 1;
+                break;
+            }
+
+        //every page has to be writable
+        for(size_t j = 0; j < m.alloc_sz / sizeof(float); j++)
+            f[j] = 1;
+
+        mat_delete(m);
+    }
+
+    return failed;
+}
+
+static void* thread_allocator(void *arg) {
+    mat_t m = mat_create(4, 4);
+    *(const mat_allocator_t**)arg = m.allocator;
+    mat_delete(m);
+    return NULL;
+}
+
+int main() {
+    int failed = 0;
+
+    failed |= check_backend("default", &mat_allocator_default);
+    failed |= check_backend("lazy", &mat_allocator_lazy);
+    failed |= check_backend("thp", &mat_allocator_thp);
+    failed |= check_backend("hugetlb", &mat_allocator_hugetlb);
+    failed |= check_backend("numa local", mat_allocator_numa(-1));
+    failed |= check_backend("numa 0", mat_allocator_numa(0));
+
+    //a matrix is freed by the allocator it came from, not the current one
+    mat_setallocator(&counting);
+    mat_t m = mat_create(30, 30);
+    mat_setallocator(&mat_allocator_lazy);
+    mat_delete(m);
+    if(m.allocator != &counting || alloc_cnt != 1 || free_cnt != 1) {
+        printf("mat_delete didn't use the matrix's own allocator\r\n");
+        failed = 1;
+    }
+
+    mat_setallocator(&mat_allocator_thp);
+    m = mat_create(600, 1000);
+    mat_setallocator(&mat_allocator_lazy);
+    mat_delete(m);
+
+    //the current allocator doesn't carry over to other threads
+    mat_setallocator(&counting);
+    const mat_allocator_t *seen = NULL;
+    pthread_t thread;
+    pthread_create(&thread, NULL, thread_allocator, &seen);
+    pthread_join(thread, NULL);
+    if(seen != &mat_allocator_default) {
+        printf("worker thread didn't start with the default allocator\r\n");
+        failed = 1;
+    }
+
+    mat_setallocator(NULL);
+    if(mat_getallocator() != &mat_allocator_default) {
+        printf("NULL didn't restore the default allocator\r\n");
+        failed = 1;
+    }
+
+    if(mat_allocator_numa(MAT_NUMA_MAX_NODES) != NULL) {
+        printf("mat_allocator_numa(%d) isn't NULL\r\n", MAT_NUMA_MAX_NODES);
+        failed = 1;
+    }
+
+    if(mat_allocator_numa(-1) == NULL || mat_allocator_numa(-1) != mat_allocator_numa(-7)) {
+        printf("negative nodes don't share one allocator\r\n");
+        failed = 1;
+    }
+
+    for(int node = 0; node < MAT_NUMA_MAX_NODES; node++) {
+        const mat_allocator_t *a = mat_allocator_numa(node);
+        if(a == NULL || a != mat_allocator_numa(node) || a == mat_allocator_numa(-1) ||
+           (node > 0 && a == mat_allocator_numa(node - 1))) {
+            printf("mat_allocator_numa(%d) isn't a stable, distinct entry\r\n", node);
+            failed = 1;
+            break;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2017 Himanshu Goel
+ *
+ * This software is released under the MIT License.
+ * https://opensource.org/licenses/MIT
+ */
+
+#include "mat.h"
+#include "ann.h"
+#include "ann_tune.h"
+
+#include <stdio.h>
+#include <math.h>
+
+#define CACHE_PATH "mat_tune_cache.txt"
+#define LOCK_PATH "mat_tune_cache.txt.lock"
+
+//none of these are multiples of 8 * strips or of unroll for every variant,
+//so the leftover strip and unroll tail paths all get exercised
+static int widths[] = {2, 3, 7, 13, 29};
+static int heights[] = {5, 9, 17, 41, 100};
+
+static int close_enough(float a, float b) {
+    return fabsf(a - b) <= 1e-4f * (1 + fabsf(b));
+}
+
+//runs every variant through mat_mult and mat_multadd and compares the
+//results against the default kernel
+static int check_shape(int w, int h) {
+    int failed = 0;
+    mat_t a = mat_create(w, h);
+    mat_t b = mat_create(1, w);
+    mat_t d = mat_create(1, h);
+    mat_t ref_mult = mat_create(1, h);
+    mat_t ref_add = mat_create(1, h);
+    mat_t c = mat_create(1, h);
+
+    for(int x = 0; x < w; x++) {
+        mat_set(b, 0, x, 1.0f / (x + 2) - 0.2f);
+        for(int y = 0; y < h; y++)
+            mat_set(a, x, y, 0.01f * ((x * 7 + y * 3) % 23) - 0.1f);
+    }
+    for(int y = 0; y < h; y++)
+        mat_set(d, 0, y, 0.05f * (y % 5) - 0.1f);
+
+    mat_mult(a, b, &ref_mult);
+    mat_multadd(a, b, d, &ref_add);
+
+    for(int v = 1; v < mat_tunecnt(); v++) {
+        mat_tune_t tune = mat_tunevariant(v);
+        if(mat_settune(&a, tune) != 0) {
+            printf("variant %d rejected by mat_settune\r\n", v);
+            failed = 1;
+            continue;
+        }
+
+        mat_clear(c);
+        mat_mult(a, b, &c);
+        for(int y = 0; y < h; y++)
+            if(!close_enough(mat_get(c, 0, y), mat_get(ref_mult, 0, y))) {
+                printf("mat_mult %dx%d differs on %dx%d at row %d\r\n", tune.strips, tune.unroll, w, h, y);
+                failed = 1;
+                break;
+            }
+
+        mat_clear(c);
+        mat_multadd(a, b, d, &c);
+        for(int y = 0; y < h; y++)
+            if(!close_enough(mat_get(c, 0, y), mat_get(ref_add, 0, y))) {
+                printf("mat_multadd %dx%d differs on %dx%d at row %d\r\n", tune.strips, tune.unroll, w, h, y);
+                failed = 1;
+                break;
+            }
+    }
+
+    mat_delete(a);
+    mat_delete(b);
+    mat_delete(d);
+    mat_delete(ref_mult);
+    mat_delete(ref_add);
+    mat_delete(c);
+
+    return failed;
+}
+
+static int check_autotune(void) {
+    int failed = 0;
+    int layers[] = {20, 33, 20};
+
+    remove(CACHE_PATH);
+    ann_t net = ann_create(3, layers, 0.1);
+    ann_t net2 = ann_create(3, layers, 0.1);
+
+    if(ann_autotune(net, CACHE_PATH) != 2) {
+        printf("first autotune didn't benchmark both shapes\r\n");
+        failed = 1;
+    }
+
+    int cnt = ann_autotune(net2, CACHE_PATH);
+    if(cnt != 0) {
+        printf("second autotune benchmarked %d shapes despite the cache\r\n", cnt);
+        failed = 1;
+    }
+
+    for(int i = 1; i < net.layers; i++)
+        if(net.weights[i].variant != net2.weights[i].variant) {
+            printf("cached variant for layer %d doesn't match\r\n", i);
+            failed = 1;
+        }
+
+    //small nets never reach mat_multadd and are skipped
+    int small[] = {4, 8, 2};
+    ann_t tiny = ann_create(3, small, 0.1);
+    if(ann_autotune(tiny, CACHE_PATH) != 0) {
+        printf("small net was tuned\r\n");
+        failed = 1;
+    }
+
+    ann_delete(net);
+    ann_delete(net2);
+    ann_delete(tiny);
+    remove(CACHE_PATH);
+    remove(LOCK_PATH);
+
+    return failed;
+}
+
+int main() {
+    int failed = 0;
+
+    for(int v = 0; v < mat_tunecnt(); v++) {
+        mat_t m = mat_create(4, 4);
+        mat_tune_t tune = mat_tunevariant(v);
+        mat_settune(&m, tune);
+        mat_tune_t got = mat_gettune(m);
+        if(got.strips != tune.strips || got.unroll != tune.unroll) {
+            printf("variant %d doesn't round trip\r\n", v);
+            failed = 1;
+        }
+        mat_delete(m);
+    }
+
+    mat_t m = mat_create(4, 4);
+    mat_tune_t bad = {3, 5};
+    if(mat_settune(&m, bad) == 0) {
+        printf("accepted unknown variant\r\n");
+        failed = 1;
+    }
+    mat_delete(m);
+
+    for(int i = 0; i < (int)(sizeof(widths) / sizeof(widths[0])); i++)
+        for(int j = 0; j < (int)(sizeof(heights) / sizeof(heights[0])); j++)
+            if(check_shape(widths[i], heights[j]))
+                failed = 1;
+
+    if(check_autotune())
+        failed = 1;
+
+    return failed;
+}